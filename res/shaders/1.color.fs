@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
 struct Material {
@@ -15,16 +15,12 @@ struct DirLight {
     vec3 specular;
 };
 
+// a point light of the cluster grid (ClusteredLighting), the attenuation terms ride in the w components
 struct PointLight {
-    vec3 position;
-    
-    float constant;
-    float linear;
-    float quadratic;
-	
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+    vec4 positionRadius;
+    vec4 ambientConstant;
+    vec4 diffuseLinear;
+    vec4 specularQuadratic;
 };
 
 struct SpotLight {
@@ -42,7 +38,18 @@ struct SpotLight {
     vec3 specular;       
 };
 
-#define NR_POINT_LIGHTS 4
+layout(std430, binding = 5) readonly buffer ClusterLights {
+    PointLight pointLights[];
+};
+layout(std430, binding = 6) readonly buffer ClusterGrid {
+    uvec4 clusterCounts;   // tiles x, tiles y, slices, lights
+    vec4 clusterScale;     // gl_FragCoord.xy to tiles, log(depth) to slices
+    vec4 clusterDepth;     // near and far plane
+    uvec2 clusterRanges[]; // offset into clusterLightIndices and light count of every cluster
+};
+layout(std430, binding = 7) readonly buffer ClusterIndices {
+    uint clusterLightIndices[];
+};
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -50,11 +57,11 @@ in vec2 TexCoords;
 
 uniform vec3 viewPos;
 uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 uniform Material material;
 
 // function prototypes
+uvec2 FindClusterLights();
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -73,9 +80,10 @@ void main()
     // == =====================================================
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+    // phase 2: point lights, only the ones of this fragment's cluster
+    uvec2 cluster = FindClusterLights();
+    for(uint i = 0; i < cluster.y; i++)
+        result += CalcPointLight(pointLights[clusterLightIndices[cluster.x + i]], norm, FragPos, viewDir);
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
     
@@ -84,6 +92,18 @@ void main()
 
 
 
+// offset and count of the lights of the cluster the fragment lies in.
+uvec2 FindClusterLights()
+{
+    // view depth from the window depth of a perspective projection
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * clusterDepth.x * clusterDepth.y / (clusterDepth.y + clusterDepth.x - ndcDepth * (clusterDepth.y - clusterDepth.x));
+    uint x = min(uint(gl_FragCoord.x * clusterScale.x), clusterCounts.x - 1);
+    uint y = min(uint(gl_FragCoord.y * clusterScale.y), clusterCounts.y - 1);
+    uint z = uint(clamp(log(depth) * clusterScale.z + clusterScale.w, 0.0, float(clusterCounts.z - 1)));
+    return clusterRanges[(z * clusterCounts.y + y) * clusterCounts.x + x];
+}
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -103,19 +123,23 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 position = light.positionRadius.xyz;
+    vec3 lightDir = normalize(position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float distance = length(position - fragPos);
+    float attenuation = 1.0 / (light.ambientConstant.w + light.diffuseLinear.w * distance + light.specularQuadratic.w * (distance * distance));
+    // faded to zero at the radius, the clusters hold no light beyond it
+    float fade = clamp(1.0 - pow(distance / light.positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= fade * fade;
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambientConstant.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuseLinear.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specularQuadratic.rgb * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// textures packed into arrays by ModelImportOptions::textureArrays, the mesh sets the layer
+uniform sampler2DArray texture_diffuse1;
+uniform int texture_diffuse1_layer;
+
+void main()
+{    
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, texture_diffuse1_layer));
+}
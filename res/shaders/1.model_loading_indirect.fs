@@ -0,0 +1,13 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in int DiffuseLayer;
+
+// texture arrays of the material, the layer comes with the draw (1.model_loading_indirect.vs)
+uniform sampler2DArray texture_diffuse1;
+
+void main()
+{    
+    FragColor = texture(texture_diffuse1, vec3(TexCoords, DiffuseLayer));
+}
@@ -0,0 +1,32 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+flat out int DiffuseLayer;
+
+struct DrawData
+{
+    mat4 model;
+    // layers of texture_diffuse1, texture_specular1, texture_normal1, texture_height1
+    ivec4 layers;
+};
+
+// one entry per command of the multi draw, see MultiDrawBatch
+layout (std430, binding = 4) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    DrawData draw = draws[gl_DrawIDARB];
+    TexCoords = aTexCoords;
+    DiffuseLayer = draw.layers.x;
+    gl_Position = projection * view * draw.model * vec4(aPos, 1.0);
+}
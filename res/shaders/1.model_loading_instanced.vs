@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance, see InstanceBuffer
+layout (location = 7) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+
+// node matrix of the mesh inside the model
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * aInstanceModel * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,39 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in ivec4 boneIds;
+layout (location = 6) in vec4 weights;
+
+out vec2 TexCoords;
+
+// palettes of all skinned draws of the frame, see BonePalette
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+    mat4 bones[];
+};
+
+uniform int boneOffset;
+uniform int boneCount;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat4 skin = mat4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (weights[i] == 0.0 || boneIds[i] < 0 || boneIds[i] >= boneCount)
+            continue;
+        skin += bones[boneOffset + boneIds[i]] * weights[i];
+        total += weights[i];
+    }
+    // vertices without weights stay in the bind pose
+    if (total == 0.0)
+        skin = mat4(1.0);
+
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * model * skin * vec4(aPos, 1.0);
+}
@@ -1,30 +1,48 @@
 #version 450 core
 
+// a point light of the cluster grid (ClusteredLighting), the attenuation terms ride in the w components
 struct PointLight {
-    vec3 position;
-    vec3 color;
-    float strength;
+    vec4 positionRadius;
+    vec4 ambientConstant;
+    vec4 diffuseLinear;
+    vec4 specularQuadratic;
+};
+
+layout(std430, binding = 5) readonly buffer ClusterLights {
+    PointLight lights[];
+};
+layout(std430, binding = 6) readonly buffer ClusterGrid {
+    uvec4 clusterCounts;   // tiles x, tiles y, slices, lights
+    vec4 clusterScale;     // gl_FragCoord.xy to tiles, log(depth) to slices
+    vec4 clusterDepth;     // near and far plane
+    uvec2 clusterRanges[]; // offset into clusterLightIndices and light count of every cluster
+};
+layout(std430, binding = 7) readonly buffer ClusterIndices {
+    uint clusterLightIndices[];
 };
 
 in vec4 fragmentPosition;
 in vec3 fragmentNormal;
 
-uniform PointLight[8] lights;
 uniform vec3 tint;
+// multiplies the color of every light
+uniform vec3 lightTint;
 
 out vec4 finalColor;
 
-vec3 calculatePointLight(int i);
+uvec2 clusterLights();
+vec3 calculatePointLight(uint i);
 
 void main()
 {
-  
+
     //ambient
     vec3 temp = 0.2 * tint;
 
-    //lighting
-    for (int i = 0; i < 8; i++) {
-        temp += calculatePointLight(i);
+    //lighting, only the lights of this fragment's cluster
+    uvec2 cluster = clusterLights();
+    for (uint i = 0; i < cluster.y; i++) {
+        temp += calculatePointLight(clusterLightIndices[cluster.x + i]);
     }
 
     finalColor = vec4(temp, 1.0);
@@ -32,16 +50,30 @@ void main()
 
 }
 
-vec3 calculatePointLight(int i) {
+uvec2 clusterLights() {
+
+    // view depth from the window depth of a perspective projection
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * clusterDepth.x * clusterDepth.y / (clusterDepth.y + clusterDepth.x - ndcDepth * (clusterDepth.y - clusterDepth.x));
+    uint x = min(uint(gl_FragCoord.x * clusterScale.x), clusterCounts.x - 1);
+    uint y = min(uint(gl_FragCoord.y * clusterScale.y), clusterCounts.y - 1);
+    uint z = uint(clamp(log(depth) * clusterScale.z + clusterScale.w, 0.0, float(clusterCounts.z - 1)));
+    return clusterRanges[(z * clusterCounts.y + y) * clusterCounts.x + x];
+}
+
+vec3 calculatePointLight(uint i) {
 
     //geometric data
-    vec3 fragmentLight = normalize(lights[i].position - vec3(fragmentPosition));
-    
+    vec3 toLight = lights[i].positionRadius.xyz - vec3(fragmentPosition);
+    vec3 fragmentLight = normalize(toLight);
+
     // get lighting level
     float level = max(0.0, dot(fragmentNormal, fragmentLight));
     // quantize the level into, say, 4 levels
     level = floor(level * 2) / 2.0;
-    vec3 result = lights[i].color * tint * level;
+    // faded to zero at the radius, the clusters hold no light beyond it
+    float fade = clamp(1.0 - pow(length(toLight) / lights[i].positionRadius.w, 4.0), 0.0, 1.0);
+    vec3 result = lights[i].diffuseLinear.rgb * lightTint * tint * level * fade * fade;
 
     return result;
-}
\ No newline at end of file
+}
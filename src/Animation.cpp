@@ -0,0 +1,226 @@
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include "glm/gtc/matrix_transform.hpp"
+#include "MappedIOSystem.h"
+
+namespace {
+
+	glm::mat4 toMat4(const aiMatrix4x4& m) {
+		// ASSIMP matrices are row major, glm ones column major
+		return glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+	}
+
+	void readNodes(std::vector<AnimationNode>& nodes, const aiNode* node, int parent) {
+		AnimationNode animationNode;
+		animationNode.name = node->mName.C_Str();
+		animationNode.parent = parent;
+		animationNode.transform = toMat4(node->mTransformation);
+		animationNode.channel = -1;
+		animationNode.bone = -1;
+		animationNode.offset = glm::mat4(1.0f);
+		nodes.push_back(animationNode);
+
+		int index = int(nodes.size()) - 1;
+		for (unsigned int i = 0; i < node->mNumChildren; ++i)
+			readNodes(nodes, node->mChildren[i], index);
+	}
+
+	// the key at or before time, starting from the key used last. time moves forward almost always,
+	// after a loop it restarts at the first key
+	unsigned int findKey(const std::vector<float>& times, float time, unsigned int cursor) {
+		if (cursor >= times.size() || times[cursor] > time)
+			cursor = 0;
+		while (cursor + 1 < times.size() && times[cursor + 1] <= time)
+			cursor++;
+		return cursor;
+	}
+
+	// interpolation factor between key and key + 1, 0 on the last key
+	float keyFactor(const std::vector<float>& times, float time, unsigned int key) {
+		if (key + 1 >= times.size())
+			return 0.0f;
+		float span = times[key + 1] - times[key];
+		return span > 0.0f ? glm::clamp((time - times[key]) / span, 0.0f, 1.0f) : 0.0f;
+	}
+}
+
+Animation::Animation() : duration(0.0f), ticksPerSecond(25.0f), boneCount(0) {
+}
+
+bool Animation::Load(const std::string& path, const BoneInfoMap& bones, unsigned int index) {
+
+	nodes.clear();
+	channels.clear();
+	boneCount = 0;
+
+	Assimp::Importer importer;
+	importer.SetIOHandler(new MappedIOSystem());
+	const aiScene* scene = importer.ReadFile(path, 0);
+	if (!scene || !scene->mRootNode) {
+		std::cout << "ERROR::ANIMATION:: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	if (index >= scene->mNumAnimations) {
+		std::cout << "ERROR::ANIMATION:: " << path << " has no animation " << index << std::endl;
+		return false;
+	}
+
+	const aiAnimation* clip = scene->mAnimations[index];
+	duration = float(clip->mDuration);
+	ticksPerSecond = clip->mTicksPerSecond > 0.0 ? float(clip->mTicksPerSecond) : 25.0f;
+
+	readNodes(nodes, scene->mRootNode, TransformHierarchy::kNoParent);
+	std::map<std::string, int> nodeIndices;
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		nodeIndices[nodes[i].name] = int(i);
+		BoneInfoMap::const_iterator bone = bones.find(nodes[i].name);
+		if (bone != bones.end()) {
+			nodes[i].bone = bone->second.id;
+			nodes[i].offset = bone->second.offset;
+		}
+	}
+	// bones without a node keep the identity in the palette
+	for (BoneInfoMap::const_iterator bone = bones.begin(); bone != bones.end(); ++bone)
+		boneCount = std::max(boneCount, size_t(bone->second.id) + 1);
+
+	channels.reserve(clip->mNumChannels);
+	for (unsigned int i = 0; i < clip->mNumChannels; ++i) {
+		const aiNodeAnim* source = clip->mChannels[i];
+		std::map<std::string, int>::iterator node = nodeIndices.find(source->mNodeName.C_Str());
+		if (node == nodeIndices.end())
+			continue;
+
+		AnimationChannel channel;
+		channel.positionTimes.reserve(source->mNumPositionKeys);
+		channel.positions.reserve(source->mNumPositionKeys);
+		for (unsigned int k = 0; k < source->mNumPositionKeys; ++k) {
+			const aiVectorKey& key = source->mPositionKeys[k];
+			channel.positionTimes.push_back(float(key.mTime));
+			channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		channel.rotationTimes.reserve(source->mNumRotationKeys);
+		channel.rotations.reserve(source->mNumRotationKeys);
+		for (unsigned int k = 0; k < source->mNumRotationKeys; ++k) {
+			const aiQuatKey& key = source->mRotationKeys[k];
+			channel.rotationTimes.push_back(float(key.mTime));
+			channel.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		channel.scaleTimes.reserve(source->mNumScalingKeys);
+		channel.scales.reserve(source->mNumScalingKeys);
+		for (unsigned int k = 0; k < source->mNumScalingKeys; ++k) {
+			const aiVectorKey& key = source->mScalingKeys[k];
+			channel.scaleTimes.push_back(float(key.mTime));
+			channel.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+
+		nodes[node->second].channel = int(channels.size());
+		channels.push_back(std::move(channel));
+	}
+	return true;
+}
+
+Animator::Animator(const Animation* animation, const CompressedClip* clip) : animation(nullptr), clip(nullptr), time(0.0f) {
+	Play(animation, clip);
+}
+
+void Animator::Play(const Animation* animation, const CompressedClip* clip) {
+	this->animation = animation;
+	// a clip of some other animation would animate the wrong channels
+	this->clip = animation && clip && clip->GetChannelCount() == animation->GetChannels().size() ? clip : nullptr;
+	time = 0.0f;
+	cursors.clear();
+	palette.clear();
+	hierarchy = TransformHierarchy();
+	if (!animation)
+		return;
+
+	const std::vector<AnimationNode>& nodes = animation->GetNodes();
+	hierarchy = TransformHierarchy(nodes.size());
+	for (const AnimationNode& node : nodes)
+		hierarchy.AddNode(node.parent, node.transform);
+	Cursor start = { 0, 0, 0 };
+	cursors.assign(animation->GetChannels().size(), start);
+	palette.assign(animation->GetBoneCount(), glm::mat4(1.0f));
+	if (this->clip) {
+		this->clip->ResetCursors(clipCursors);
+		positions.resize(this->clip->GetChannelCount());
+		rotations.resize(this->clip->GetChannelCount());
+		scales.resize(this->clip->GetChannelCount());
+	}
+	sample();
+}
+
+void Animator::Update(float deltaSeconds) {
+	if (!animation)
+		return;
+	float duration = animation->GetDurationInTicks();
+	time += deltaSeconds * animation->GetTicksPerSecond();
+	time = duration > 0.0f ? fmodf(time, duration) : 0.0f;
+	if (time < 0.0f)
+		time += duration;
+	sample();
+}
+
+void Animator::SetTime(float seconds) {
+	if (!animation)
+		return;
+	time = 0.0f;
+	Update(seconds);
+}
+
+void Animator::sample() {
+
+	const std::vector<AnimationNode>& nodes = animation->GetNodes();
+	const std::vector<AnimationChannel>& channels = animation->GetChannels();
+	if (clip)
+		clip->Sample(time, clipCursors, positions.data(), rotations.data(), scales.data());
+
+	// only animated nodes get new local matrices, the hierarchy recomputes them and their subtrees
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		int c = nodes[i].channel;
+		if (c < 0)
+			continue;
+		if (clip) {
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[c]) * glm::mat4_cast(rotations[c]);
+			hierarchy.SetLocal(int(i), glm::scale(local, scales[c]));
+			continue;
+		}
+		const AnimationChannel& channel = channels[c];
+		Cursor& cursor = cursors[c];
+
+		glm::vec3 position(0.0f);
+		if (!channel.positions.empty()) {
+			cursor.position = findKey(channel.positionTimes, time, cursor.position);
+			unsigned int next = std::min(cursor.position + 1, unsigned(channel.positions.size()) - 1);
+			position = glm::mix(channel.positions[cursor.position], channel.positions[next],
+				keyFactor(channel.positionTimes, time, cursor.position));
+		}
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		if (!channel.rotations.empty()) {
+			cursor.rotation = findKey(channel.rotationTimes, time, cursor.rotation);
+			unsigned int next = std::min(cursor.rotation + 1, unsigned(channel.rotations.size()) - 1);
+			rotation = glm::normalize(glm::slerp(channel.rotations[cursor.rotation], channel.rotations[next],
+				keyFactor(channel.rotationTimes, time, cursor.rotation)));
+		}
+		glm::vec3 scale(1.0f);
+		if (!channel.scales.empty()) {
+			cursor.scale = findKey(channel.scaleTimes, time, cursor.scale);
+			unsigned int next = std::min(cursor.scale + 1, unsigned(channel.scales.size()) - 1);
+			scale = glm::mix(channel.scales[cursor.scale], channel.scales[next],
+				keyFactor(channel.scaleTimes, time, cursor.scale));
+		}
+
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(rotation);
+		hierarchy.SetLocal(int(i), glm::scale(local, scale));
+	}
+	hierarchy.Update();
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i].bone >= 0)
+			palette[nodes[i].bone] = hierarchy.GetWorld(int(i)) * nodes[i].offset;
+	}
+}
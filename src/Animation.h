@@ -0,0 +1,108 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/ext/vector_float3.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "TransformHierarchy.h"
+#include "AnimationClip.h"
+
+// A bone referenced by the skinned meshes of a model. id is its slot in the bone palette,
+// offset takes mesh space into the bone's space in the bind pose.
+struct BoneInfo {
+	int id;
+	glm::mat4 offset;
+};
+
+typedef std::map<std::string, BoneInfo> BoneInfoMap;
+
+// Keys of one animated node, every track sorted by time (in ticks).
+struct AnimationChannel {
+	std::vector<float> positionTimes;
+	std::vector<glm::vec3> positions;
+	std::vector<float> rotationTimes;
+	std::vector<glm::quat> rotations;
+	std::vector<float> scaleTimes;
+	std::vector<glm::vec3> scales;
+};
+
+// A node of the animated hierarchy. nodes are stored parent before child, like TransformHierarchy.
+struct AnimationNode {
+	std::string name;
+	int parent;
+	// the aiNode transformation, used while no channel animates the node
+	glm::mat4 transform;
+	// index into Animation::channels or -1
+	int channel;
+	// palette slot or -1 for nodes that only carry their children
+	int bone;
+	glm::mat4 offset;
+};
+
+// One clip of a file read through ASSIMP, together with the node tree it animates.
+class Animation {
+public:
+	Animation();
+
+	// reads clip index of the file at path. bones maps the bone names of the skinned meshes to palette slots,
+	// channels of bones the meshes don't know are sampled for the hierarchy but produce no palette entry
+	bool Load(const std::string& path, const BoneInfoMap& bones, unsigned int index = 0);
+
+	const std::vector<AnimationNode>& GetNodes() const { return nodes; }
+	const std::vector<AnimationChannel>& GetChannels() const { return channels; }
+	// duration in seconds
+	float GetDuration() const { return duration / ticksPerSecond; }
+	float GetTicksPerSecond() const { return ticksPerSecond; }
+	float GetDurationInTicks() const { return duration; }
+	// largest palette slot used plus one
+	size_t GetBoneCount() const { return boneCount; }
+
+private:
+	std::vector<AnimationNode> nodes;
+	std::vector<AnimationChannel> channels;
+	float duration;
+	float ticksPerSecond;
+	size_t boneCount;
+};
+
+// Plays an animation: samples the channels, composes the node hierarchy and writes the bone palette
+// (model space skinning matrices, globalTransform * offset) for the vertex shader or geometry::skinVertices.
+// every channel keeps the key it used last, so playing forward finds the next keys without a search.
+// with a CompressedClip of the animation the keys are decoded from the clip and the Animation only supplies the nodes.
+class Animator {
+public:
+	explicit Animator(const Animation* animation = nullptr, const CompressedClip* clip = nullptr);
+
+	void Play(const Animation* animation, const CompressedClip* clip = nullptr);
+	// advances by deltaSeconds, looping, and recomputes the palette
+	void Update(float deltaSeconds);
+	// jumps to seconds into the clip and recomputes the palette
+	void SetTime(float seconds);
+
+	float GetTime() const { return time / (animation ? animation->GetTicksPerSecond() : 1.0f); }
+	const std::vector<glm::mat4>& GetPalette() const { return palette; }
+
+private:
+	struct Cursor {
+		unsigned int position;
+		unsigned int rotation;
+		unsigned int scale;
+	};
+
+	const Animation* animation;
+	const CompressedClip* clip;
+	// current time in ticks
+	float time;
+	std::vector<Cursor> cursors;
+	TransformHierarchy hierarchy;
+	std::vector<glm::mat4> palette;
+	// decoded channels of the compressed clip
+	ClipCursors clipCursors;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+
+	void sample();
+};
@@ -0,0 +1,448 @@
+#include "AnimationClip.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "glm/common.hpp"
+#include "Animation.h"
+#include "AssetFile.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ANIMATION_CLIP_SSE
+#endif
+
+namespace {
+
+	const uint32_t kClipMagic = 0x50494c43; // "CLIP"
+	const uint32_t kClipVersion = 1;
+	const float kSqrt2 = 1.41421356f;
+
+	struct ClipHeader {
+		uint32_t magic;
+		uint32_t version;
+		float duration;
+		float ticksPerSecond;
+		uint32_t channelCount;
+		uint32_t keyCount;
+	};
+
+	// four lanes of floats, SSE registers when available
+#ifdef ANIMATION_CLIP_SSE
+	typedef __m128 float4;
+	inline float4 load4(const float* p) { return _mm_load_ps(p); }
+	inline void store4(float* p, float4 v) { _mm_store_ps(p, v); }
+	inline float4 splat4(float v) { return _mm_set1_ps(v); }
+	inline float4 add4(float4 a, float4 b) { return _mm_add_ps(a, b); }
+	inline float4 sub4(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+	inline float4 mul4(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+	inline float4 max4(float4 a, float4 b) { return _mm_max_ps(a, b); }
+	inline float4 sqrt4(float4 a) { return _mm_sqrt_ps(a); }
+	inline float4 div4(float4 a, float4 b) { return _mm_div_ps(a, b); }
+	// -b where mask (a < 0) is set, b otherwise
+	inline float4 negateIfNegative4(float4 a, float4 b) { return _mm_xor_ps(b, _mm_and_ps(_mm_cmplt_ps(a, _mm_setzero_ps()), _mm_set1_ps(-0.0f))); }
+#else
+	struct float4 {
+		float v[4];
+	};
+	inline float4 load4(const float* p) { float4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+	inline void store4(float* p, float4 v) { memcpy(p, v.v, sizeof(v.v)); }
+	inline float4 splat4(float v) { float4 r = { { v, v, v, v } }; return r; }
+	inline float4 add4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+	inline float4 sub4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+	inline float4 mul4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+	inline float4 max4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+	inline float4 sqrt4(float4 a) { for (int i = 0; i < 4; ++i) a.v[i] = sqrtf(a.v[i]); return a; }
+	inline float4 div4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) a.v[i] /= b.v[i]; return a; }
+	inline float4 negateIfNegative4(float4 a, float4 b) { for (int i = 0; i < 4; ++i) if (a.v[i] < 0.0f) b.v[i] = -b.v[i]; return b; }
+#endif
+
+	// keeps the fewest keys that linear interpolation between them reproduces all source keys from within tolerance.
+	// greedy: every segment is extended from its first key as far as it stays within the tolerance
+	template<typename T, typename Lerp, typename Error>
+	void reduceKeys(std::vector<uint32_t>& kept, const std::vector<float>& times, const std::vector<T>& values,
+		float tolerance, Lerp lerp, Error error) {
+
+		kept.clear();
+		size_t count = std::min(times.size(), values.size());
+		if (count == 0)
+			return;
+		kept.push_back(0);
+
+		bool constant = true;
+		for (size_t i = 1; i < count && constant; ++i)
+			constant = error(values[0], values[i]) <= tolerance;
+		if (constant)
+			return;
+
+		auto fits = [&](size_t start, size_t end) {
+			float span = times[end] - times[start];
+			for (size_t i = start + 1; i < end; ++i) {
+				float factor = span > 0.0f ? (times[i] - times[start]) / span : 0.0f;
+				if (error(lerp(values[start], values[end], factor), values[i]) > tolerance)
+					return false;
+			}
+			return true;
+		};
+
+		size_t start = 0;
+		while (start + 1 < count) {
+			size_t end = start + 1;
+			while (end + 1 < count && fits(start, end + 1))
+				end++;
+			kept.push_back(uint32_t(end));
+			start = end;
+		}
+	}
+
+	glm::quat nlerp(const glm::quat& a, const glm::quat& b, float factor) {
+		// source rotations are made hemisphere continuous before reduction, no sign flip needed here
+		return glm::normalize(a * (1.0f - factor) + b * factor);
+	}
+
+	float angleBetween(const glm::quat& a, const glm::quat& b) {
+		return 2.0f * acosf(std::min(1.0f, fabsf(glm::dot(glm::normalize(a), glm::normalize(b)))));
+	}
+
+	uint16_t quantizeUnit(float value) {
+		return uint16_t(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+
+	CompressedTrack packVectors(CompressedClip& clip, const std::vector<uint32_t>& kept, const std::vector<float>& times,
+		const std::vector<glm::vec3>& values, float duration) {
+
+		CompressedTrack track;
+		track.firstKey = uint32_t(clip.keys.size());
+		track.keyCount = uint32_t(kept.size());
+		track.minimum = glm::vec3(0.0f);
+		track.extent = glm::vec3(0.0f);
+		if (kept.empty())
+			return track;
+
+		glm::vec3 minimum = values[kept[0]], maximum = values[kept[0]];
+		for (uint32_t k : kept) {
+			minimum = glm::min(minimum, values[k]);
+			maximum = glm::max(maximum, values[k]);
+		}
+		track.minimum = minimum;
+		track.extent = maximum - minimum;
+		for (uint32_t k : kept) {
+			PackedKey key;
+			for (int c = 0; c < 3; ++c)
+				key.values[c] = track.extent[c] > 0.0f ? quantizeUnit((values[k][c] - minimum[c]) / track.extent[c]) : 0;
+			clip.keys.push_back(key);
+			clip.times.push_back(quantizeUnit(duration > 0.0f ? times[k] / duration : 0.0f));
+		}
+		return track;
+	}
+
+	// the two keys around time and the factor between them, advancing the track's cursor
+	inline float locate(const CompressedClip& clip, const CompressedTrack& track, float time, uint32_t& cursor, uint32_t& a, uint32_t& b) {
+		const uint16_t* times = &clip.times[track.firstKey];
+		uint32_t count = track.keyCount;
+		if (cursor >= count || times[cursor] > time)
+			cursor = 0;
+		while (cursor + 1 < count && times[cursor + 1] <= time)
+			cursor++;
+		a = track.firstKey + cursor;
+		if (cursor + 1 >= count) {
+			b = a;
+			return 0.0f;
+		}
+		b = a + 1;
+		float span = float(times[cursor + 1]) - float(times[cursor]);
+		return span > 0.0f ? glm::clamp((time - float(times[cursor])) / span, 0.0f, 1.0f) : 0.0f;
+	}
+
+	// decodes position or scale tracks, four at a time. tracks without keys produce fallback
+	void sampleVectors(const CompressedClip& clip, const std::vector<CompressedTrack>& tracks, float time,
+		std::vector<uint32_t>& cursors, const glm::vec3& fallback, glm::vec3* output) {
+
+		alignas(16) float keyA[3][4], keyB[3][4], minimum[3][4], extent[3][4], factor[4], result[3][4];
+		for (size_t base = 0; base < tracks.size(); base += 4) {
+			size_t lanes = std::min<size_t>(4, tracks.size() - base);
+			for (size_t lane = 0; lane < 4; ++lane) {
+				factor[lane] = 0.0f;
+				if (lane >= lanes || tracks[base + lane].keyCount == 0) {
+					for (int c = 0; c < 3; ++c) {
+						keyA[c][lane] = keyB[c][lane] = 0.0f;
+						minimum[c][lane] = lane < lanes ? fallback[c] : 0.0f;
+						extent[c][lane] = 0.0f;
+					}
+					continue;
+				}
+				const CompressedTrack& track = tracks[base + lane];
+				uint32_t a, b;
+				factor[lane] = locate(clip, track, time, cursors[base + lane], a, b);
+				for (int c = 0; c < 3; ++c) {
+					keyA[c][lane] = clip.keys[a].values[c];
+					keyB[c][lane] = clip.keys[b].values[c];
+					minimum[c][lane] = track.minimum[c];
+					extent[c][lane] = track.extent[c] * (1.0f / 65535.0f);
+				}
+			}
+
+			// interpolation is linear, so the quantized keys are blended first and dequantized once
+			float4 f = load4(factor);
+			for (int c = 0; c < 3; ++c) {
+				float4 a = load4(keyA[c]);
+				float4 blended = add4(a, mul4(sub4(load4(keyB[c]), a), f));
+				store4(result[c], add4(load4(minimum[c]), mul4(blended, load4(extent[c]))));
+			}
+			for (size_t lane = 0; lane < lanes; ++lane)
+				output[base + lane] = glm::vec3(result[0][lane], result[1][lane], result[2][lane]);
+		}
+	}
+
+	void unpackBits(const PackedKey& key, int& largest, float* components) {
+		uint64_t bits = uint64_t(key.values[0]) | (uint64_t(key.values[1]) << 16) | (uint64_t(key.values[2]) << 32);
+		largest = int((bits >> 45) & 3);
+		components[0] = float((bits >> 30) & 0x7fff);
+		components[1] = float((bits >> 15) & 0x7fff);
+		components[2] = float(bits & 0x7fff);
+	}
+
+	// smallest-three components of four keys from 0..32767 to the quaternion, in xyzw lanes
+	void decodeQuaternions(float (*packed)[4], const int* largest, float (*quaternion)[4]) {
+		float4 scale = splat4(2.0f / 32767.0f / kSqrt2), offset = splat4(1.0f / kSqrt2);
+		float4 c0 = sub4(mul4(load4(packed[0]), scale), offset);
+		float4 c1 = sub4(mul4(load4(packed[1]), scale), offset);
+		float4 c2 = sub4(mul4(load4(packed[2]), scale), offset);
+		float4 squares = add4(add4(mul4(c0, c0), mul4(c1, c1)), mul4(c2, c2));
+		float4 dropped = sqrt4(max4(sub4(splat4(1.0f), squares), splat4(0.0f)));
+
+		alignas(16) float values[4][4];
+		store4(values[0], c0);
+		store4(values[1], c1);
+		store4(values[2], c2);
+		store4(values[3], dropped);
+		for (int lane = 0; lane < 4; ++lane) {
+			int next = 0;
+			for (int i = 0; i < 4; ++i)
+				quaternion[i][lane] = i == largest[lane] ? values[3][lane] : values[next++][lane];
+		}
+	}
+}
+
+CompressedClip::CompressedClip() : duration(0.0f), ticksPerSecond(25.0f) {
+}
+
+size_t CompressedClip::GetMemoryBytes() const {
+	return (positionTracks.size() + rotationTracks.size() + scaleTracks.size()) * sizeof(CompressedTrack) +
+		times.size() * sizeof(uint16_t) + keys.size() * sizeof(PackedKey);
+}
+
+void CompressedClip::ResetCursors(ClipCursors& cursors) const {
+	cursors.positions.assign(positionTracks.size(), 0);
+	cursors.rotations.assign(rotationTracks.size(), 0);
+	cursors.scales.assign(scaleTracks.size(), 0);
+}
+
+void CompressedClip::Sample(float time, ClipCursors& cursors, glm::vec3* positions, glm::quat* rotations, glm::vec3* scales) const {
+
+	if (cursors.positions.size() != positionTracks.size() || cursors.rotations.size() != rotationTracks.size() ||
+		cursors.scales.size() != scaleTracks.size())
+		ResetCursors(cursors);
+
+	float normalizedTime = duration > 0.0f ? glm::clamp(time / duration, 0.0f, 1.0f) * 65535.0f : 0.0f;
+	sampleVectors(*this, positionTracks, normalizedTime, cursors.positions, glm::vec3(0.0f), positions);
+	sampleVectors(*this, scaleTracks, normalizedTime, cursors.scales, glm::vec3(1.0f), scales);
+
+	alignas(16) float packedA[3][4], packedB[3][4], factor[4], a[4][4], b[4][4], result[4][4];
+	int largestA[4], largestB[4];
+	for (size_t base = 0; base < rotationTracks.size(); base += 4) {
+		size_t lanes = std::min<size_t>(4, rotationTracks.size() - base);
+		for (size_t lane = 0; lane < 4; ++lane) {
+			factor[lane] = 0.0f;
+			if (lane >= lanes || rotationTracks[base + lane].keyCount == 0) {
+				// the identity: every stored component 0 and w dropped
+				largestA[lane] = largestB[lane] = 3;
+				for (int c = 0; c < 3; ++c)
+					packedA[c][lane] = packedB[c][lane] = 32767.0f * 0.5f;
+				continue;
+			}
+			uint32_t keyA, keyB;
+			factor[lane] = locate(*this, rotationTracks[base + lane], normalizedTime, cursors.rotations[base + lane], keyA, keyB);
+			float components[3];
+			unpackBits(keys[keyA], largestA[lane], components);
+			for (int c = 0; c < 3; ++c)
+				packedA[c][lane] = components[c];
+			unpackBits(keys[keyB], largestB[lane], components);
+			for (int c = 0; c < 3; ++c)
+				packedB[c][lane] = components[c];
+		}
+		decodeQuaternions(packedA, largestA, a);
+		decodeQuaternions(packedB, largestB, b);
+
+		// normalized lerp along the shorter arc
+		float4 x0 = load4(a[0]), y0 = load4(a[1]), z0 = load4(a[2]), w0 = load4(a[3]);
+		float4 x1 = load4(b[0]), y1 = load4(b[1]), z1 = load4(b[2]), w1 = load4(b[3]);
+		float4 dot = add4(add4(mul4(x0, x1), mul4(y0, y1)), add4(mul4(z0, z1), mul4(w0, w1)));
+		float4 f = load4(factor);
+		float4 g = sub4(splat4(1.0f), f);
+		float4 h = negateIfNegative4(dot, f);
+		float4 x = add4(mul4(x0, g), mul4(x1, h));
+		float4 y = add4(mul4(y0, g), mul4(y1, h));
+		float4 z = add4(mul4(z0, g), mul4(z1, h));
+		float4 w = add4(mul4(w0, g), mul4(w1, h));
+		float4 length = sqrt4(add4(add4(mul4(x, x), mul4(y, y)), add4(mul4(z, z), mul4(w, w))));
+		length = max4(length, splat4(1e-12f));
+		store4(result[0], div4(x, length));
+		store4(result[1], div4(y, length));
+		store4(result[2], div4(z, length));
+		store4(result[3], div4(w, length));
+		for (size_t lane = 0; lane < lanes; ++lane)
+			rotations[base + lane] = glm::quat(result[3][lane], result[0][lane], result[1][lane], result[2][lane]);
+	}
+}
+
+bool CompressedClip::Save(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::CLIP:: can't write " << path << std::endl;
+		return false;
+	}
+	ClipHeader header = { kClipMagic, kClipVersion, duration, ticksPerSecond, uint32_t(positionTracks.size()), uint32_t(keys.size()) };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(positionTracks.data()), positionTracks.size() * sizeof(CompressedTrack));
+	file.write(reinterpret_cast<const char*>(rotationTracks.data()), rotationTracks.size() * sizeof(CompressedTrack));
+	file.write(reinterpret_cast<const char*>(scaleTracks.data()), scaleTracks.size() * sizeof(CompressedTrack));
+	file.write(reinterpret_cast<const char*>(times.data()), times.size() * sizeof(uint16_t));
+	file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(PackedKey));
+	return bool(file);
+}
+
+bool CompressedClip::Load(const std::string& path) {
+	AssetFile file(path);
+	if (!file.IsOpen()) {
+		std::cout << "ERROR::CLIP:: can't open " << path << std::endl;
+		return false;
+	}
+
+	ClipHeader header;
+	if (file.GetSize() < sizeof(header)) {
+		std::cout << "ERROR::CLIP:: " << path << " is truncated" << std::endl;
+		return false;
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+	size_t trackBytes = size_t(header.channelCount) * sizeof(CompressedTrack);
+	size_t expected = sizeof(header) + 3 * trackBytes + size_t(header.keyCount) * (sizeof(uint16_t) + sizeof(PackedKey));
+	if (header.magic != kClipMagic || header.version != kClipVersion || file.GetSize() != expected) {
+		std::cout << "ERROR::CLIP:: " << path << " is not a valid clip" << std::endl;
+		return false;
+	}
+
+	const char* data = file.GetData() + sizeof(header);
+	std::vector<CompressedTrack>* tracks[3] = { &positionTracks, &rotationTracks, &scaleTracks };
+	for (std::vector<CompressedTrack>* list : tracks) {
+		list->resize(header.channelCount);
+		memcpy(list->data(), data, trackBytes);
+		data += trackBytes;
+		for (const CompressedTrack& track : *list) {
+			if (track.firstKey > header.keyCount || track.keyCount > header.keyCount - track.firstKey) {
+				std::cout << "ERROR::CLIP:: " << path << " has a track outside its keys" << std::endl;
+				return false;
+			}
+		}
+	}
+	times.resize(header.keyCount);
+	memcpy(times.data(), data, times.size() * sizeof(uint16_t));
+	data += times.size() * sizeof(uint16_t);
+	keys.resize(header.keyCount);
+	memcpy(keys.data(), data, keys.size() * sizeof(PackedKey));
+	duration = header.duration;
+	ticksPerSecond = header.ticksPerSecond;
+	return true;
+}
+
+void geometry::compressAnimation(CompressedClip& clip, const Animation& animation, const ClipCompressionSettings& settings) {
+
+	const std::vector<AnimationChannel>& channels = animation.GetChannels();
+	clip = CompressedClip();
+	clip.duration = animation.GetDurationInTicks();
+	clip.ticksPerSecond = animation.GetTicksPerSecond();
+	clip.positionTracks.reserve(channels.size());
+	clip.rotationTracks.reserve(channels.size());
+	clip.scaleTracks.reserve(channels.size());
+
+	auto lerp = [](const glm::vec3& a, const glm::vec3& b, float factor) { return glm::mix(a, b, factor); };
+	auto distance = [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b); };
+	auto largestDifference = [](const glm::vec3& a, const glm::vec3& b) {
+		glm::vec3 d = glm::abs(a - b);
+		return std::max(d.x, std::max(d.y, d.z));
+	};
+
+	std::vector<uint32_t> kept;
+	std::vector<glm::quat> rotations;
+	for (const AnimationChannel& channel : channels) {
+		reduceKeys(kept, channel.positionTimes, channel.positions, settings.positionTolerance, lerp, distance);
+		clip.positionTracks.push_back(packVectors(clip, kept, channel.positionTimes, channel.positions, clip.duration));
+
+		// neighbouring keys on the same hemisphere, so plain lerp takes the short way like the runtime nlerp
+		rotations = channel.rotations;
+		for (size_t i = 0; i < rotations.size(); ++i) {
+			rotations[i] = glm::normalize(rotations[i]);
+			if (i > 0 && glm::dot(rotations[i - 1], rotations[i]) < 0.0f)
+				rotations[i] = -rotations[i];
+		}
+		reduceKeys(kept, channel.rotationTimes, rotations, settings.rotationTolerance, nlerp, angleBetween);
+		CompressedTrack track;
+		track.firstKey = uint32_t(clip.keys.size());
+		track.keyCount = uint32_t(kept.size());
+		track.minimum = glm::vec3(0.0f);
+		track.extent = glm::vec3(0.0f);
+		for (uint32_t k : kept) {
+			clip.keys.push_back(packQuaternion(rotations[k]));
+			clip.times.push_back(quantizeUnit(clip.duration > 0.0f ? channel.rotationTimes[k] / clip.duration : 0.0f));
+		}
+		clip.rotationTracks.push_back(track);
+
+		reduceKeys(kept, channel.scaleTimes, channel.scales, settings.scaleTolerance, lerp, largestDifference);
+		clip.scaleTracks.push_back(packVectors(clip, kept, channel.scaleTimes, channel.scales, clip.duration));
+	}
+}
+
+PackedKey geometry::packQuaternion(const glm::quat& rotation) {
+	glm::quat q = glm::normalize(rotation);
+	float components[4] = { q.x, q.y, q.z, q.w };
+	int largest = 0;
+	for (int i = 1; i < 4; ++i) {
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+	// q and -q are the same rotation, the dropped component is always stored as positive
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint64_t bits = uint64_t(largest) << 45;
+	int shift = 30;
+	for (int i = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		// the other three are within +-1/sqrt(2)
+		float unit = glm::clamp(components[i] * sign * kSqrt2, -1.0f, 1.0f) * 0.5f + 0.5f;
+		bits |= uint64_t(unit * 32767.0f + 0.5f) << shift;
+		shift -= 15;
+	}
+	PackedKey key;
+	key.values[0] = uint16_t(bits & 0xffff);
+	key.values[1] = uint16_t((bits >> 16) & 0xffff);
+	key.values[2] = uint16_t((bits >> 32) & 0xffff);
+	return key;
+}
+
+glm::quat geometry::unpackQuaternion(const PackedKey& key) {
+	int largest;
+	float components[3];
+	unpackBits(key, largest, components);
+	float values[4];
+	float squares = 0.0f;
+	for (int c = 0; c < 3; ++c) {
+		components[c] = (components[c] * (2.0f / 32767.0f) - 1.0f) / kSqrt2;
+		squares += components[c] * components[c];
+	}
+	int next = 0;
+	for (int i = 0; i < 4; ++i)
+		values[i] = i == largest ? sqrtf(std::max(0.0f, 1.0f - squares)) : components[next++];
+	return glm::quat(values[3], values[0], values[1], values[2]);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "glm/ext/vector_float3.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+class Animation;
+
+// How far the compressed clip may deviate from the source keys.
+struct ClipCompressionSettings {
+	// model units
+	float positionTolerance = 0.001f;
+	// radians
+	float rotationTolerance = 0.001f;
+	float scaleTolerance = 0.001f;
+};
+
+// A key is three 16-bit values: a position or scale quantized to the range of its track,
+// or a rotation as smallest-three (2 bits index of the dropped component, 3 x 15 bits of the others).
+struct PackedKey {
+	uint16_t values[3];
+};
+
+// The keys of one position, rotation or scale track, a range of CompressedClip::times/keys.
+// position and scale keys decode to minimum + extent * key / 65535.
+struct CompressedTrack {
+	uint32_t firstKey;
+	uint32_t keyCount;
+	glm::vec3 minimum;
+	glm::vec3 extent;
+};
+
+static_assert(sizeof(PackedKey) == 6, "PackedKey is written as is");
+static_assert(sizeof(CompressedTrack) == 32, "CompressedTrack is written as is");
+
+// Per track key cursors of a playing clip, owned by the player so many instances can share one clip.
+struct ClipCursors {
+	std::vector<uint32_t> positions;
+	std::vector<uint32_t> rotations;
+	std::vector<uint32_t> scales;
+};
+
+// An Animation's channels after key reduction and quantization. channel i here is channel i of the Animation
+// it was compressed from, the node tree and bones stay with that Animation.
+class CompressedClip {
+public:
+	float duration;
+	float ticksPerSecond;
+	std::vector<CompressedTrack> positionTracks;
+	std::vector<CompressedTrack> rotationTracks;
+	std::vector<CompressedTrack> scaleTracks;
+	// key times normalized to 0..65535 over the duration
+	std::vector<uint16_t> times;
+	std::vector<PackedKey> keys;
+
+	CompressedClip();
+
+	size_t GetChannelCount() const { return positionTracks.size(); }
+	size_t GetMemoryBytes() const;
+
+	// decodes every channel at time (in ticks) into the output arrays of GetChannelCount() entries.
+	// four tracks are dequantized and interpolated at once, rotations with normalized lerp
+	void Sample(float time, ClipCursors& cursors, glm::vec3* positions, glm::quat* rotations, glm::vec3* scales) const;
+	void ResetCursors(ClipCursors& cursors) const;
+
+	// binary .clip files, for compressing offline and loading through AssetFile (and the pack archive)
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+};
+
+namespace geometry {
+
+	// reduces every track of the animation to the fewest keys that linear interpolation turns back into the source
+	// within the tolerances, then quantizes what is left
+	void compressAnimation(CompressedClip& clip, const Animation& animation, const ClipCompressionSettings& settings = ClipCompressionSettings());
+
+	PackedKey packQuaternion(const glm::quat& rotation);
+	glm::quat unpackQuaternion(const PackedKey& key);
+}
@@ -11,6 +11,15 @@
 #include <array>
 #include "glm/gtc/type_ptr.hpp"
 #include "Light.h"
+#include "PackArchive.h"
+#include "RenderQueue.h"
+#include "Culling.h"
+#include "SceneBvh.h"
+#include "OcclusionBuffer.h"
+#include "HiZCulling.h"
+#include "UploadRing.h"
+#include "JobSystem.h"
+#include "ClusteredLighting.h"
 
 
 struct LightLocation {
@@ -23,9 +32,46 @@ struct LightLocation {
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(const char* path);
 
+// a model drawn by the render queue, the queue has made its shader current
+struct ModelDraw {
+    Model* model;
+    Shader* shader;
+    glm::mat4 transform;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    // first matrix of the model's bone palette, -1 draws without skinning and with cluster culling
+    int boneOffset;
+    int boneCount;
+};
+
+// what the simulation of a frame hands to its rendering. the next frame is simulated into one of two states
+// while the current one is drawn from the other, which nothing writes to in the meantime
+struct SceneState {
+    // the active camera with the input of the frame applied
+    Camera camera;
+    glm::mat4 wolfLocal;
+    std::vector<glm::vec3> controlPoints;
+    std::vector<glm::mat4> bones;
+    float time;
+};
+
+// meshes of several models collected for one multi draw, drawn with the shader's view/projection
+struct BatchDraw {
+    MultiDrawBatch* batch;
+    Shader* shader;
+};
+
+void drawModel(const void* object, unsigned int argument);
+void drawBatch(const void* object, unsigned int argument);
+void drawCubeInstances(const void* object, unsigned int argument);
+void drawCubesIndirect(const void* object, unsigned int argument);
+void drawSurface(const void* object, unsigned int argument);
+float viewDepth(const glm::mat4& model, const glm::mat4& view);
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -45,6 +91,8 @@ Camera* currentCamera = &camera1;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+// set by a left click, the loop casts a ray through the middle of the screen (the cursor is captured)
+bool pickRequested = false;
 
 // timing
 float deltaTime = 0.0f;
@@ -84,12 +132,18 @@ int main()
     camera3.isFollowing = true;
     camera3.isMoving = true;
 
-      
+
+    // res/ is served from the archive built by tools/packer when there is one, loose files are the fallback
+    if (PackArchive::Mount("res.pak"))
+        std::cout << "PACK:: res.pak mounted, " << PackArchive::Mounted()->GetEntryCount() << " files" << std::endl;
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // direct state access needs 4.5, which also brings the compute shaders and storage buffers (4.3) and the
+    // persistently mapped buffers (4.4) the renderer is built on
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     #ifdef __APPLE__
@@ -101,7 +155,7 @@ int main()
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        std::cout << "Failed to create GLFW window, an OpenGL 4.5 core context is required" << std::endl;
         glfwTerminate();
         return -1;
     }
@@ -109,6 +163,7 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -128,10 +183,19 @@ int main()
 
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader lightingShader("res/shaders/1.color.vs", "res/shaders/1.color.fs");
-    Shader lightCubeShader("res/shaders/1.light_cube.vs", "res/shaders/1.light_cube.fs");
+    // the cubes are drawn instanced, their model matrices come from an InstanceBuffer
+    Shader lightingShader("res/shaders/1.color_instanced.vs", "res/shaders/1.color.fs");
+    Shader lightCubeShader("res/shaders/1.light_cube_instanced.vs", "res/shaders/1.light_cube.fs");
 
-    Shader modelShader("res/shaders/1.model_loading.vs", "res/shaders/1.model_loading.fs");
+    // the models are imported with texture arrays, see importOptions below
+    Shader modelShader("res/shaders/1.model_loading.vs", "res/shaders/1.model_loading_array.fs");
+    // same material, vertices skinned with the bone palette
+    Shader skinnedShader("res/shaders/1.model_loading_skinned.vs", "res/shaders/1.model_loading_array.fs");
+    // unskinned models are drawn with one multi draw indirect per material and index type when gl_DrawID is available
+    // (ARB_shader_draw_parameters, core only from 4.6), the model matrices and texture layers come from a storage buffer then
+    unique_ptr<Shader> indirectShader;
+    if (GLEW_ARB_shader_draw_parameters)
+        indirectShader.reset(new Shader("res/shaders/1.model_loading_indirect.vs", "res/shaders/1.model_loading_indirect.fs"));
 
 
     // surface Shader
@@ -149,9 +213,10 @@ int main()
     filepaths.tcs = "res/shaders/Surface.tcs";
     filepaths.tes = "res/shaders/Surface.tes";
     filepaths.fragment = "res/shaders/Surface.fs";
+    filepaths.compute = NULL;
     surfaceShader = util::load_shader(filepaths);
-    ShaderLocation SLcameraPos, SLmodel, SLview, SLprojection, SLtint;
-    LightLocation lights, toonLights, surfaceLights;
+    ShaderLocation SLcameraPos, SLmodel, SLview, SLprojection, SLtint, SLlightTint;
+    LightLocation lights, toonLights;
     DynamicSurface* surfaceMesh = new DynamicSurface();
 
 
@@ -160,18 +225,7 @@ int main()
     SLview.surface = glGetUniformLocation(surfaceShader, "view");
     SLprojection.surface = glGetUniformLocation(surfaceShader, "projection");
     SLtint.surface = glGetUniformLocation(surfaceShader, "tint");
-    std::stringstream location;
-    for (int i = 0; i < 8; i++) {
-        location.str("");
-        location << "lights[" << i << "].color";
-        surfaceLights.colorLoc[i] = glGetUniformLocation(surfaceShader, location.str().c_str());
-        location.str("");
-        location << "lights[" << i << "].position";
-        surfaceLights.positionLoc[i] = glGetUniformLocation(surfaceShader, location.str().c_str());
-        location.str("");
-        location << "lights[" << i << "].strength";
-        surfaceLights.strengthLoc[i] = glGetUniformLocation(surfaceShader, location.str().c_str());
-    }
+    SLlightTint.surface = glGetUniformLocation(surfaceShader, "lightTint");
     
 
     std::vector<Light*> lightsArray;
@@ -181,6 +235,7 @@ int main()
     lightInfo.color = glm::vec3(1, 0, 0);
     lightInfo.position = glm::vec3(1, 0, 0);
     lightInfo.strength = 4.0f;
+    lightInfo.radius = 4.0f;
     lightsArray.push_back(new Light(&lightInfo));
     lightInfo.color = glm::vec3(0, 1, 0);
     lightInfo.position = glm::vec3(3, 2, 0);
@@ -188,6 +243,18 @@ int main()
     lightInfo.color = glm::vec3(0, 1, 1);
     lightInfo.position = glm::vec3(3, 0, 2);
     lightsArray.push_back(new Light(&lightInfo));
+    // a field of small lights under the scene, the light clusters keep every pixel down to the few around it
+    lightInfo.strength = 1.0f;
+    lightInfo.radius = 2.5f;
+    for (int x = 0; x < 16; x++)
+    {
+        for (int z = 0; z < 16; z++)
+        {
+            lightInfo.position = glm::vec3(-15.0f + 2.0f * x, -2.0f, -20.0f + 2.0f * z);
+            lightInfo.color = glm::vec3(0.5f + 0.5f * sin(0.9f * x), 0.5f + 0.5f * sin(1.3f * z + 2.0f), 0.5f + 0.5f * sin(0.7f * (x + z) + 4.0f));
+            lightsArray.push_back(new Light(&lightInfo));
+        }
+    }
    
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -256,6 +323,14 @@ int main()
         glm::vec3(0.0f,  0.0f, -3.0f)
     };
 
+    // every point light of the scene, shaded through the light clusters
+    std::vector<ClusteredLighting::PointLight> pointLights;
+    for (const glm::vec3& position : pointLightPositions)
+        pointLights.push_back(ClusteredLighting::MakePointLight(position, glm::vec3(0.05f), glm::vec3(0.8f), glm::vec3(1.0f), 1.0f, 0.09f, 0.032f));
+    for (const Light* light : lightsArray)
+        pointLights.push_back(ClusteredLighting::MakePointLight(*light));
+    ClusteredLighting clusteredLighting;
+
     for(unsigned int i = 0; i < 10; i++)
     {
         glm::mat4 model = glm::mat4(1.0f);
@@ -296,6 +371,38 @@ int main()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    // everything rewritten every frame (instance transforms, bone palettes, the surface's control points, the
+    // multi draw commands) is copied into a persistently mapped ring, a region per frame in flight
+    UploadRing uploadRing;
+
+    // per-instance model matrices of the light cubes, refilled every frame. the containers get theirs from the GPU culling
+    InstanceBuffer lightCubeInstances(4);
+    lightCubeInstances.Attach(lightCubeVAO);
+    glm::mat4 lightCubeTransforms[4];
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        lightCubeTransforms[i] = glm::mat4(1.0f);
+        lightCubeTransforms[i] = glm::translate(lightCubeTransforms[i], pointLightPositions[i]);
+        lightCubeTransforms[i] = glm::scale(lightCubeTransforms[i], glm::vec3(0.2f)); // Make it a smaller cube
+    }
+
+    // bounding spheres of the light cubes for the frustum culling, a unit cube fits into a sphere of radius sqrt(3) / 2
+    SphereBounds lightCubeBounds;
+    for (unsigned int i = 0; i < 4; i++)
+        lightCubeBounds.Add(pointLightPositions[i], 0.2f * 0.866f);
+    unsigned char lightCubeVisible[4];
+    glm::mat4 visibleTransforms[10], visibleLightTransforms[4];
+
+    // the containers are culled on the GPU, against the frustum and the depth of the previous frame. their instance
+    // attribute reads the transforms the culling shader wrote
+    util::shaderFilePathBundle downsamplePaths = { NULL, NULL, NULL, NULL, NULL, "res/shaders/HiZDownsample.comp" };
+    util::shaderFilePathBundle cullPaths = { NULL, NULL, NULL, NULL, NULL, "res/shaders/HiZCull.comp" };
+    HiZCulling hiZCulling(util::load_shader(downsamplePaths), util::load_shader(cullPaths), 10);
+    hiZCulling.Attach(cubeVAO);
+    glm::vec4 cubeSpheres[10];
+    for (unsigned int i = 0; i < 10; i++)
+        cubeSpheres[i] = glm::vec4(cubePositions[i], 0.866f);
+
     // load texture 
     // -------------------------
     unsigned int diffuseMap = loadTexture("res/textures/container2.png");
@@ -307,8 +414,75 @@ int main()
     lightingShader.setInt("material.diffuse", 0);
     lightingShader.setInt("material.specular", 1);
 
-    Model ourModel((string)"res/models/house/house.obj");
-    Model wolfModel((string)"res/models/Wolf/Wolf.obj");
+    ModelImportOptions importOptions;
+    importOptions.weldVertices = true;
+    importOptions.optimizeMeshes = true;
+    importOptions.buildMeshlets = true;
+    importOptions.generateLods = true;
+    importOptions.textureArrays = true;
+    importOptions.printStatistics = true;
+    // both models are suballocated from one set of buffers
+    shared_ptr<GeometryArena> sceneGeometry = make_shared<GeometryArena>();
+    // the house hides whatever is behind it, it keeps its full detail triangles for the occlusion rasterizer
+    ModelImportOptions houseOptions = importOptions;
+    houseOptions.occluderLod = 0;
+    Model ourModel((string)"res/models/house/house.obj", false, houseOptions, sceneGeometry);
+    string wolfPath = "res/models/Wolf/Wolf.obj";
+    Model wolfModel(wolfPath, false, importOptions, sceneGeometry);
+
+    // a rigged wolf plays its first clip, the OBJ one has no skeleton and is drawn without skinning
+    BonePalette bonePalette;
+    Animation wolfAnimation;
+    CompressedClip wolfClip;
+    Animator wolfAnimator;
+    if (!wolfModel.boneInfoMap.empty() && wolfAnimation.Load(wolfPath, wolfModel.boneInfoMap))
+    {
+        // played from the reduced and quantized keys
+        geometry::compressAnimation(wolfClip, wolfAnimation);
+        wolfAnimator.Play(&wolfAnimation, &wolfClip);
+    }
+
+    // the wolf hangs off the house, the house never moves so only the wolf's world matrix is recomputed per frame
+    TransformHierarchy sceneNodes;
+    glm::mat4 houseLocal = glm::mat4(1.0f);
+    houseLocal = glm::translate(houseLocal, glm::vec3(3.0f, 3.0f, 0.0f)); // translate it down so it's at the center of the scene
+    houseLocal = glm::scale(houseLocal, glm::vec3(0.5f, 0.5f, 0.5f));	// it's a bit too big for our scene, so scale it down
+    int houseNode = sceneNodes.AddNode(TransformHierarchy::kNoParent, houseLocal);
+    int wolfNode = sceneNodes.AddNode(houseNode);
+    sceneNodes.Update();
+
+    // world space boxes of everything in the scene for visibility, picking and proximity queries.
+    // only the wolf moves, its box is refitted every frame
+    SceneBvh sceneBvh;
+    vector<string> sceneObjectNames;
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        sceneBvh.AddObject(cubePositions[i] - glm::vec3(0.866f), cubePositions[i] + glm::vec3(0.866f));
+        sceneObjectNames.push_back("container " + to_string(i));
+    }
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        sceneBvh.AddObject(pointLightPositions[i] - glm::vec3(0.1f), pointLightPositions[i] + glm::vec3(0.1f));
+        sceneObjectNames.push_back("light " + to_string(i));
+    }
+    glm::vec3 houseMin, houseMax, wolfMin, wolfMax, boundsMin, boundsMax;
+    ourModel.GetBounds(houseMin, houseMax);
+    geometry::transformBox(houseMin, houseMax, sceneNodes.GetWorld(houseNode), boundsMin, boundsMax);
+    int houseObject = sceneBvh.AddObject(boundsMin, boundsMax);
+    sceneObjectNames.push_back("house");
+    // the bind pose box with room for the animation to move the limbs out of it
+    wolfModel.GetBounds(wolfMin, wolfMax);
+    glm::vec3 wolfMargin = (wolfMax - wolfMin) * 0.25f;
+    wolfMin -= wolfMargin;
+    wolfMax += wolfMargin;
+    geometry::transformBox(wolfMin, wolfMax, sceneNodes.GetWorld(wolfNode), boundsMin, boundsMax);
+    int wolfObject = sceneBvh.AddObject(boundsMin, boundsMax);
+    sceneObjectNames.push_back("wolf");
+    sceneBvh.Build();
+    vector<int> sceneObjects;
+    vector<unsigned char> sceneObjectVisible(sceneBvh.GetObjectCount());
+    // CPU depth buffer of the house at a quarter of the window size, objects behind it are left out of the draw list
+    OcclusionBuffer occlusionBuffer(SCR_WIDTH / 4, SCR_HEIGHT / 4);
 
 
   
@@ -316,225 +490,358 @@ int main()
     
     //glm::vec3 fogColor = glm::vec3(0.8, 0.8, 0.8); // Kolor mgy
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
-    {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-        // display camera position
-        cout << "Camera position: " << currentCamera->Position.x << " " << currentCamera->Position.y << " " << currentCamera->Position.z << endl;
-        // display camera direction
-        cout << "Camera direction: " << currentCamera->Front.x << " " << currentCamera->Front.y << " " << currentCamera->Front.z << endl;
-
-        // render
-        // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // be sure to activate shader when setting uniforms/drawing objects
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", currentCamera->Position);
-        lightingShader.setFloat("material.shininess", 32.0f);
-
-        /*
-           Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
-           the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
-           by defining light types as classes and set their values in there, or by using a more efficient uniform approach
-           by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
-        */
-        // directional light
-        lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // point light 1
-        lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-        lightingShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[0].constant", 1.0f);
-        lightingShader.setFloat("pointLights[0].linear", 0.09f);
-        lightingShader.setFloat("pointLights[0].quadratic", 0.032f);
-        // point light 2
-        lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-        lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[1].constant", 1.0f);
-        lightingShader.setFloat("pointLights[1].linear", 0.09f);
-        lightingShader.setFloat("pointLights[1].quadratic", 0.032f);
-        // point light 3
-        lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-        lightingShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[2].constant", 1.0f);
-        lightingShader.setFloat("pointLights[2].linear", 0.09f);
-        lightingShader.setFloat("pointLights[2].quadratic", 0.032f);
-        // point light 4
-        lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-        lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        lightingShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("pointLights[3].constant", 1.0f);
-        lightingShader.setFloat("pointLights[3].linear", 0.09f);
-        lightingShader.setFloat("pointLights[3].quadratic", 0.032f);
-        // spotLight
-        lightingShader.setVec3("spotLight.position", currentCamera->Position);
-        lightingShader.setVec3("spotLight.direction", currentCamera->Front);
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        lightingShader.setFloat("spotLight.constant", 1.0f);
-        lightingShader.setFloat("spotLight.linear", 0.09f);
-        lightingShader.setFloat("spotLight.quadratic", 0.032f);
-        lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(currentCamera->Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = currentCamera->GetViewMatrix();
+    // every draw of a frame goes through the render queue. the programs set their per-frame uniforms once when the
+    // queue switches to them, the values are read from these, which the loop fills before executing the queue
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    // the camera and the simulation time of the frame being drawn, input has already moved the live ones on
+    Camera renderCamera;
+    float renderTime = 0.0f;
+    ModelDraw houseDraw = { &ourModel, &modelShader, glm::mat4(1.0f), glm::mat4(1.0f), glm::vec3(0.0f), -1, 0 };
+    ModelDraw wolfDraw = { &wolfModel, &skinnedShader, glm::mat4(1.0f), glm::mat4(1.0f), glm::vec3(0.0f), -1, 0 };
+    if (wolfAnimator.GetPalette().empty())
+        wolfDraw.shader = &modelShader;
+
+    RenderQueue renderQueue;
+    unsigned int lightingProgram = renderQueue.AddProgram(lightingShader.ID, [&]() {
+            lightingShader.setVec3("viewPos", renderCamera.Position);
+            lightingShader.setFloat("material.shininess", 32.0f);
+
+            /*
+               Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
+               the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
+               by defining light types as classes and set their values in there, or by using a more efficient uniform approach
+               by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
+            */
+            // directional light
+            lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
+            lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
+            lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
+            lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+            // the point lights come from the light clusters
+            // spotLight
+            lightingShader.setVec3("spotLight.position", renderCamera.Position);
+            lightingShader.setVec3("spotLight.direction", renderCamera.Front);
+            lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+            lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
+            lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
+            lightingShader.setFloat("spotLight.constant", 1.0f);
+            lightingShader.setFloat("spotLight.linear", 0.09f);
+            lightingShader.setFloat("spotLight.quadratic", 0.032f);
+            lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+            lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
         lightingShader.setMat4("projection", projection);
         lightingShader.setMat4("view", view);
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        lightingShader.setMat4("model", model);
-
+    });
+    unsigned int lightCubeProgram = renderQueue.AddProgram(lightCubeShader.ID, [&]() {
+        lightCubeShader.setMat4("projection", projection);
+        lightCubeShader.setMat4("view", view);
+    });
+    unsigned int modelProgram = renderQueue.AddProgram(modelShader.ID, [&]() {
+        modelShader.setMat4("projection", projection);
+        modelShader.setMat4("view", view);
+    });
+    unsigned int indirectProgram = 0;
+    if (indirectShader)
+    {
+        indirectProgram = renderQueue.AddProgram(indirectShader->ID, [&]() {
+            indirectShader->setMat4("projection", projection);
+            indirectShader->setMat4("view", view);
+        });
+    }
+    MultiDrawBatch staticBatch(uploadRing);
+    BatchDraw staticDraw = { &staticBatch, indirectShader.get() };
+    unsigned int skinnedProgram = renderQueue.AddProgram(skinnedShader.ID, [&]() {
+        skinnedShader.setMat4("projection", projection);
+        skinnedShader.setMat4("view", view);
+    });
+    unsigned int surfaceProgram = renderQueue.AddProgram(surfaceShader, [&]() {
+            glUniformMatrix4fv(
+                SLprojection.surface,
+                1, GL_FALSE, glm::value_ptr(projection)
+            );
+            glUniform1f(glGetUniformLocation(surfaceShader, "detail"), 40);
+
+            // the lights themselves come from the light clusters, the surface tints them
+            glm::vec3 lightColor;
+            lightColor.x = sin(renderTime * 2.0f);
+            lightColor.y = sin(renderTime * 0.7f);
+            lightColor.z = sin(renderTime * 1.3f);
+            glUniform3fv(SLlightTint.surface, 1, glm::value_ptr(lightColor));
+
+            glUniformMatrix4fv(SLview.surface, 1, GL_FALSE,
+                glm::value_ptr(view)
+            );
+
+            glUniformMatrix4fv(SLmodel.surface, 1, GL_FALSE,
+                glm::value_ptr(glm::mat4(1.0))
+            );
+            glUniform3fv(SLtint.surface, 1, glm::value_ptr(surface->color));
+    });
+    unsigned int containerMaterial = renderQueue.AddMaterial([&]() {
         // bind diffuse map
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, diffuseMap);
         // bind specular map
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, specularMap);
+    });
+    renderQueue.SetPassSetup(RenderQueue::kPassSurface, []() {
+        glPatchParameteri(GL_PATCH_VERTICES, 16);
+        glDisable(GL_CULL_FACE);
+    });
 
-        // render containers
-        glBindVertexArray(cubeVAO);
-        for (unsigned int i = 0; i < 10; i++)
-        {
-            // calculate the model matrix for each object and pass it to shader before drawing
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cubePositions[i]);
+    // the frame's draws are recorded by jobs, into one command buffer per worker
+    JobSystem& jobs = JobSystem::Get();
+    vector<RenderQueue::CommandBuffer> frameCommands(jobs.GetWorkerCount());
 
-            // rotate models in time 
-            model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+    // the simulation (wolf path, the following camera, the surface, the wolf's animation) of the next frame runs as a
+    // job while this thread draws the current one, so a frame takes the longer of the two instead of their sum.
+    // input is still sampled here, the simulation only gets a copy of the camera it moved
+    auto simulate = [&](SceneState& state, float time, float step) {
+        state.time = time;
 
-            float angle = 20.0f * i;
-           // model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            lightingShader.setMat4("model", model);
+        // center of the house is at 3,3,0
+        // make the wolf cirlce around the house
+        float radius = 12.0f;
+        float wolf_x = static_cast<float>(3 + sin(time) * radius);
+        float wolf_y = static_cast<float>(0);
+        float wolf_z = static_cast<float>(cos(time) * radius);
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        glm::mat4 wolfLocal = glm::mat4(1.0f);
+        wolfLocal = glm::scale(wolfLocal, glm::vec3(0.5f, 0.5f, 0.5f));	// it's a bit too big for our scene, so scale it down
+        wolfLocal = glm::translate(wolfLocal, glm::vec3(wolf_x, wolf_y, wolf_z)); // translate it down so it's at the center of the scene
+        wolfLocal = glm::rotate(wolfLocal, time * glm::radians(50.f), glm::vec3(0.0f, 1.0f, 0.0f));
+        state.wolfLocal = wolfLocal;
 
-        // also draw the lamp object(s)
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
+        if (state.camera.isFollowing) {
+            state.camera.Position = glm::vec3(wolf_x, wolf_y + 1, wolf_z);
+            state.camera.Front = glm::vec3(3 - wolf_x,wolf_y, 0 - wolf_z);
+        }
 
-        // we now draw as many light bulbs as we have point lights.
-        glBindVertexArray(lightCubeVAO);
-        for (unsigned int i = 0; i < 4; i++)
+        surface->Update(time/256.0f);
+        state.controlPoints = surface->controlPoints;
+        if (!wolfAnimator.GetPalette().empty())
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            lightCubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            wolfAnimator.Update(step);
+            state.bones = wolfAnimator.GetPalette();
         }
+    };
+    SceneState states[2];
+    unsigned int current = 0;
+    states[current].camera = *currentCamera;
+    simulate(states[current], static_cast<float>(glfwGetTime()), 0.0f);
 
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        uploadRing.BeginFrame();
 
-        // don't forget to enable shader before setting uniforms
-        modelShader.use();
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
+        // input
+        // -----
+        processInput(window);
 
-        // render the loaded model
-        glm::mat4 model1 = glm::mat4(1.0f);
-        model1 = glm::translate(model1, glm::vec3(3.0f, 3.0f, 0.0f)); // translate it down so it's at the center of the scene
-        model1 = glm::scale(model1, glm::vec3(0.5f, 0.5f, 0.5f));	// it's a bit too big for our scene, so scale it down
-        modelShader.setMat4("model", model1);
-        ourModel.Draw(modelShader);
+        // the next frame is simulated while this one is drawn from its state
+        const SceneState& state = states[current];
+        SceneState& nextState = states[current ^ 1];
+        nextState.camera = *currentCamera;
+        JobSystem::Counter simulation;
+        jobs.Run([&](unsigned int) { simulate(nextState, currentFrame, deltaTime); }, &simulation);
 
+        renderCamera = state.camera;
+        renderTime = state.time;
+        // display camera position
+        cout << "Camera position: " << renderCamera.Position.x << " " << renderCamera.Position.y << " " << renderCamera.Position.z << endl;
+        // display camera direction
+        cout << "Camera direction: " << renderCamera.Front.x << " " << renderCamera.Front.y << " " << renderCamera.Front.z << endl;
 
-     
-        // center of the house is at 3,3,0
-        // make the wolf cirlce around the house
+        sceneNodes.SetLocal(wolfNode, state.wolfLocal);
+        sceneNodes.Update();
 
-          // Upadting cameras:
-        float radius = 12.0f;
-        float wolf_x = static_cast<float>(3 + sin(glfwGetTime()) * radius);
-        float wolf_y = static_cast<float>(0);
-        float wolf_z = static_cast<float>(cos(glfwGetTime()) * radius);
-
-        glm::mat4 model3 = glm::mat4(1.0f);
-      
-        //model3 = glm::rotate(model3, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model3 = glm::scale(model1, glm::vec3(0.5f, 0.5f, 0.5f));	// it's a bit too big for our scene, so scale it down
-        model3 = glm::translate(model3, glm::vec3(wolf_x, wolf_y, wolf_z)); // translate it down so it's at the center of the scene
-        model3 = glm::rotate(model3, (float)glfwGetTime() * glm::radians(50.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        if (currentCamera->isFollowing) {
-            currentCamera->Position = glm::vec3(wolf_x, wolf_y + 1, wolf_z);
-            currentCamera->Front = glm::vec3(3 - wolf_x,wolf_y, 0 - wolf_z);
+        // view/projection transformations
+        projection = glm::perspective(glm::radians(renderCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        view = renderCamera.GetViewMatrix();
+        const Frustum& frustum = renderCamera.GetFrustum(projection);
+
+        // the CPU side of the frame (transforms, culling, level of detail, instance data, the draw packets, the
+        // light lists of the clusters) is recorded by jobs, every worker into its own command buffer. the jobs make no GL calls, the uploads and
+        // the draws follow on this thread once they are done. the occlusion tests wait for the house to be
+        // rasterized, the surface and the scene queries below don't
+        size_t visibleCount = 0, lightVisibleCount = 0;
+        for (RenderQueue::CommandBuffer& commands : frameCommands)
+            commands.Clear();
+        JobSystem::Counter occluders, frameJobs;
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        jobs.Run([&](unsigned int) {
+            clusteredLighting.Assign(view, projection, framebufferWidth, framebufferHeight, pointLights.data(), pointLights.size());
+        }, &frameJobs);
+        jobs.Run([&](unsigned int) {
+            occlusionBuffer.Begin(projection * view);
+            ourModel.RenderOccluders(occlusionBuffer, sceneNodes.GetWorld(houseNode));
+            occlusionBuffer.Rasterize();
+        }, &occluders);
+
+        // only the light cubes inside the view frustum and not hidden by the house go into the instance buffer
+        geometry::cullSpheres(frustum, lightCubeBounds, lightCubeVisible);
+
+        geometry::transformBox(wolfMin, wolfMax, sceneNodes.GetWorld(wolfNode), boundsMin, boundsMax);
+        sceneBvh.SetBounds(wolfObject, boundsMin, boundsMax);
+        sceneBvh.Update();
+        sceneObjects.clear();
+        sceneBvh.QueryFrustum(frustum, sceneObjects);
+        fill(sceneObjectVisible.begin(), sceneObjectVisible.end(), 0);
+        for (int object : sceneObjects)
+            sceneObjectVisible[object] = 1;
+
+        if (pickRequested)
+        {
+            pickRequested = false;
+            glm::vec3 direction = renderCamera.GetRayDirection(projection, SCR_WIDTH * 0.5f, SCR_HEIGHT * 0.5f, (float)SCR_WIDTH, (float)SCR_HEIGHT);
+            float distance;
+            int picked = sceneBvh.Raycast(renderCamera.Position, direction, 100.0f, &distance);
+            if (picked == SceneBvh::kNoObject)
+                cout << "PICK:: nothing" << endl;
+            else
+            {
+                sceneObjects.clear();
+                size_t nearby = sceneBvh.QueryRadius(renderCamera.Position + direction * distance, 3.0f, sceneObjects);
+                cout << "PICK:: " << sceneObjectNames[picked] << " at " << distance << ", " << nearby - 1 << " more objects within 3 units" << endl;
+            }
         }
-            
 
-        modelShader.setMat4("model", model3);
-        wolfModel.Draw(modelShader);
-
-
-        // render surface
-      
-        glUseProgram(surfaceShader);
-        glPatchParameteri(GL_PATCH_VERTICES, 16);
-        glDisable(GL_CULL_FACE);
+        auto recordJob = [&](size_t job, unsigned int worker) {
+            RenderQueue::CommandBuffer& commands = frameCommands[worker];
+            switch (job)
+            {
+            case 0:
+                // containers, one indirect instanced draw. the GPU sees every cube and decides itself
+                for (unsigned int i = 0; i < 10; i++)
+                {
+                    // calculate the model matrix for each object
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cubePositions[i]);
+
+                    // rotate models in time 
+                    model = glm::rotate(model, state.time * glm::radians(50.0f), glm::vec3(0.5f, 1.0f, 0.0f));
+                    visibleTransforms[visibleCount++] = model;
+                }
+                commands.Submit(RenderQueue::kPassOpaque, lightingProgram, containerMaterial, cubeVAO, 0.0f, drawCubesIndirect, &hiZCulling);
+                break;
+            case 1:
+                // we now draw as many light bulbs as we have point lights, in one instanced draw
+                for (unsigned int i = 0; i < 4; i++)
+                {
+                    if (lightCubeVisible[i] && occlusionBuffer.IsBoxVisible(pointLightPositions[i] - glm::vec3(0.1f), pointLightPositions[i] + glm::vec3(0.1f)))
+                        visibleLightTransforms[lightVisibleCount++] = lightCubeTransforms[i];
+                }
+                if (lightVisibleCount > 0)
+                    commands.Submit(RenderQueue::kPassOpaque, lightCubeProgram, 0, lightCubeVAO, 0.0f, drawCubeInstances, &lightCubeInstances);
+                break;
+            case 2:
+            {
+                bool wolfDrawn = sceneObjectVisible[wolfObject] && occlusionBuffer.IsBoxVisible(boundsMin, boundsMax);
+                houseDraw.transform = sceneNodes.GetWorld(houseNode);
+                houseDraw.viewProjection = projection * view;
+                houseDraw.cameraPosition = renderCamera.Position;
+                ourModel.SelectLod(renderCamera, houseDraw.transform, (float)SCR_HEIGHT);
+
+                wolfDraw.transform = sceneNodes.GetWorld(wolfNode);
+                wolfDraw.viewProjection = projection * view;
+                wolfDraw.cameraPosition = renderCamera.Position;
+                wolfModel.SelectLod(renderCamera, wolfDraw.transform, (float)SCR_HEIGHT);
+                if (!state.bones.empty())
+                {
+                    bonePalette.Clear();
+                    wolfDraw.boneOffset = bonePalette.Add(state.bones);
+                    wolfDraw.boneCount = static_cast<int>(state.bones.size());
+                }
+
+                // the loaded models bind their own textures and geometry. the house and an unskinned wolf share the arena and
+                // go out together in the multi draw when there is one
+                bool batchHouse = indirectShader && sceneObjectVisible[houseObject];
+                bool batchWolf = indirectShader && wolfDrawn && wolfDraw.boneOffset < 0;
+                if (indirectShader)
+                {
+                    staticBatch.Clear();
+                    if (batchHouse)
+                        ourModel.AppendDraws(staticBatch, houseDraw.transform, houseDraw.viewProjection);
+                    if (batchWolf)
+                        wolfModel.AppendDraws(staticBatch, wolfDraw.transform, wolfDraw.viewProjection);
+                    if (staticBatch.GetDrawCount() > 0)
+                        commands.Submit(RenderQueue::kPassOpaque, indirectProgram, 0, sceneGeometry->VAO, 0.0f, drawBatch, &staticDraw);
+                }
+                if (sceneObjectVisible[houseObject] && !batchHouse)
+                    commands.Submit(RenderQueue::kPassOpaque, modelProgram, 0, 0, viewDepth(houseDraw.transform, view), drawModel, &houseDraw);
+                if (wolfDrawn && !batchWolf)
+                    commands.Submit(RenderQueue::kPassOpaque, wolfDraw.boneOffset >= 0 ? skinnedProgram : modelProgram, 0, 0,
+                        viewDepth(wolfDraw.transform, view), drawModel, &wolfDraw);
+                break;
+            }
+            case 3:
+            {
+                // the patch stays inside the convex hull of its control points, their box bounds it
+                BoxBounds surfaceBounds;
+                glm::vec3 surfaceMin = state.controlPoints[0], surfaceMax = state.controlPoints[0];
+                for (const glm::vec3& point : state.controlPoints)
+                {
+                    surfaceMin = glm::min(surfaceMin, point);
+                    surfaceMax = glm::max(surfaceMax, point);
+                }
+                surfaceBounds.Add(surfaceMin, surfaceMax);
+                unsigned char surfaceVisible;
+                geometry::cullBoxes(frustum, surfaceBounds, &surfaceVisible);
+                // render surface
+                if (surfaceVisible)
+                    commands.Submit(RenderQueue::kPassSurface, surfaceProgram, 0, surfaceMesh->VAO, 0.0f, drawSurface, surfaceMesh);
+                break;
+            }
+            }
+        };
+        jobs.Run([&](unsigned int worker) { recordJob(3, worker); }, &frameJobs);
+        for (size_t job = 0; job < 3; job++)
+            jobs.RunAfter(occluders, [&, job](unsigned int worker) { recordJob(job, worker); }, &frameJobs);
+        jobs.Wait(frameJobs);
+
+        // uploads of what the jobs prepared
+        hiZCulling.SetInstances(uploadRing, visibleTransforms, cubeSpheres, visibleCount);
+        hiZCulling.Cull(projection * view, 36);
+        lightCubeInstances.Upload(uploadRing, visibleLightTransforms, lightVisibleCount);
+        lightCubeInstances.Attach(lightCubeVAO);
+        if (!state.bones.empty())
+            bonePalette.Upload(uploadRing);
+        surfaceMesh->build(uploadRing, state.controlPoints);
+        clusteredLighting.Upload(uploadRing);
 
-        glUniformMatrix4fv(
-            SLprojection.surface,
-            1, GL_FALSE, glm::value_ptr(projection)
-        );
-        glUniform1f(glGetUniformLocation(surfaceShader, "detail"), 40);
-
-        // loog through all pointLightPositions
-        
-        
-        glm::vec3 lightColor;
-        lightColor.x = sin(glfwGetTime() * 2.0f);
-        lightColor.y = sin(glfwGetTime() * 0.7f);
-        lightColor.z = sin(glfwGetTime() * 1.3f);
-  
-        for (int i = 0; i < 4; i ++) {
-            glUniform3fv(surfaceLights.colorLoc[i], 1, glm::value_ptr(lightColor));
-            glUniform3fv(surfaceLights.positionLoc[i], 1, glm::value_ptr(pointLightPositions[i]));
-            glUniform1f(surfaceLights.strengthLoc[i], 1.0f);
-        }
-
-        glUniformMatrix4fv(SLview.surface, 1, GL_FALSE,
-            glm::value_ptr(view)
-        );
+        // render
+        // ------
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUniformMatrix4fv(SLmodel.surface, 1, GL_FALSE,
-            glm::value_ptr(glm::mat4(1.0))
-        );
-        glUniform3fv(SLtint.surface, 1, glm::value_ptr(surface->color));
+        // the queue sorts the draws by pass, program, material and VAO, submission order doesn't matter
+        renderQueue.Clear();
+        for (const RenderQueue::CommandBuffer& commands : frameCommands)
+            renderQueue.Append(commands);
+        renderQueue.Sort();
+        renderQueue.Execute();
 
-        surface->Update(currentFrame/256.0f);
-        surfaceMesh->build(surface->controlPoints);
-        glBindVertexArray(surfaceMesh->VAO);
-        glDrawArrays(GL_PATCHES, 0, 16);
+        // the depth of this frame is what the containers are culled against in the next one
+        hiZCulling.BuildPyramid(framebufferWidth, framebufferHeight, projection * view);
+        uploadRing.EndFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        jobs.Wait(simulation);
+        current ^= 1;
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -550,6 +857,54 @@ int main()
     return 0;
 }
 
+// render queue draws
+// ------------------
+void drawModel(const void* object, unsigned int /*argument*/)
+{
+    const ModelDraw& draw = *static_cast<const ModelDraw*>(object);
+    draw.shader->setMat4("model", draw.transform);
+    if (draw.boneOffset >= 0)
+    {
+        // cluster bounds are in the bind pose, skinned meshes are drawn whole
+        draw.shader->setInt("boneOffset", draw.boneOffset);
+        draw.shader->setInt("boneCount", draw.boneCount);
+        draw.model->Draw(*draw.shader, draw.transform);
+    }
+    else
+        draw.model->DrawClusters(*draw.shader, draw.transform, draw.viewProjection, draw.cameraPosition);
+}
+
+void drawBatch(const void* object, unsigned int /*argument*/)
+{
+    const BatchDraw& draw = *static_cast<const BatchDraw*>(object);
+    Shader& shader = *draw.shader;
+    draw.batch->Draw([&](const void* material) {
+        static_cast<Mesh*>(const_cast<void*>(material))->BindMaterial(shader);
+    });
+}
+
+void drawCubeInstances(const void* object, unsigned int /*argument*/)
+{
+    const InstanceBuffer& instances = *static_cast<const InstanceBuffer*>(object);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<GLsizei>(instances.GetCount()));
+}
+
+void drawCubesIndirect(const void* object, unsigned int /*argument*/)
+{
+    static_cast<const HiZCulling*>(object)->Draw(GL_TRIANGLES);
+}
+
+void drawSurface(const void* /*object*/, unsigned int /*argument*/)
+{
+    glDrawArrays(GL_PATCHES, 0, 16);
+}
+
+// distance of the model's origin in front of the camera over the far plane, the depth of a render queue key
+float viewDepth(const glm::mat4& model, const glm::mat4& view)
+{
+    return -(view * model[3]).z / 100.0f;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow* window)
@@ -607,6 +962,14 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     currentCamera->ProcessMouseMovement(xoffset, yoffset);
 }
 
+// glfw: whenever a mouse button is pressed or released, this callback is called
+// ----------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+        pickRequested = true;
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -622,7 +985,8 @@ unsigned int loadTexture(char const* path)
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+    AssetFile file(path);
+    unsigned char* data = file.IsOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.GetData()), static_cast<int>(file.GetSize()), &width, &height, &nrComponents, 0) : nullptr;
     if (data)
     {
         GLenum format;
@@ -0,0 +1,48 @@
+#include "AssetFile.h"
+#include "PackArchive.h"
+
+namespace {
+	// data of a successfully opened empty entry, IsOpen needs a non-null pointer
+	const char emptyAsset[1] = { 0 };
+}
+
+AssetFile::AssetFile() : data(nullptr), size(0) {
+}
+
+AssetFile::AssetFile(const std::string& path) : AssetFile() {
+	Open(path);
+}
+
+bool AssetFile::Open(const std::string& path) {
+	Close();
+
+	const PackArchive* archive = PackArchive::Mounted();
+	const pack::Entry* entry = archive ? archive->Find(path) : nullptr;
+	if (entry) {
+		size = size_t(entry->size);
+		if (!(entry->flags & pack::kFlagLz4)) {
+			data = size > 0 ? archive->GetStoredData(*entry) : emptyAsset;
+			return true;
+		}
+		buffer.resize(size + 1);
+		if (!archive->Extract(*entry, buffer.data())) {
+			Close();
+			return false;
+		}
+		data = buffer.data();
+		return true;
+	}
+
+	if (!file.Open(path))
+		return false;
+	data = file.GetData();
+	size = file.GetSize();
+	return true;
+}
+
+void AssetFile::Close() {
+	file.Close();
+	std::vector<char>().swap(buffer);
+	data = nullptr;
+	size = 0;
+}
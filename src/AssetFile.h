@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// The contents of a resource file: taken from the mounted PackArchive when it contains the path, memory mapped
+// from disk otherwise. loose files and uncompressed pack entries aren't copied, LZ4 entries are decoded into
+// a buffer owned by the AssetFile.
+class AssetFile {
+public:
+	AssetFile();
+	explicit AssetFile(const std::string& path);
+	AssetFile(const AssetFile&) = delete;
+	AssetFile& operator=(const AssetFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	std::string ToString() const { return std::string(data ? data : "", size); }
+
+private:
+	MappedFile file;
+	std::vector<char> buffer;
+	const char* data;
+	size_t size;
+};
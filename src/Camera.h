@@ -5,6 +5,7 @@
 #include "glm/fwd.hpp"
 #include "glm/ext/matrix_transform.hpp"
 #include <GL/glew.h>
+#include "Frustum.h"
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
@@ -68,6 +69,29 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // world space frustum planes for the given projection, extracted again only when the camera or the projection changed
+    const Frustum& GetFrustum(const glm::mat4& projection)
+    {
+        if (!frustumValid || Position != frustumPosition || Front != frustumFront || Up != frustumUp || projection != frustumProjection)
+        {
+            frustum = Frustum::FromMatrix(projection * GetViewMatrix());
+            frustumPosition = Position;
+            frustumFront = Front;
+            frustumUp = Up;
+            frustumProjection = projection;
+            frustumValid = true;
+        }
+        return frustum;
+    }
+
+    // world space direction of the ray from Position through the pixel x, y of a width x height viewport (y down like the cursor)
+    glm::vec3 GetRayDirection(const glm::mat4& projection, float x, float y, float width, float height)
+    {
+        glm::vec4 clip(2.0f * x / width - 1.0f, 1.0f - 2.0f * y / height, 1.0f, 1.0f);
+        glm::vec4 world = glm::inverse(projection * GetViewMatrix()) * clip;
+        return glm::normalize(glm::vec3(world) / world.w - Position);
+    }
+
     // Front vector setter
     void SetFront(glm::vec3 front) {
 		Front = front;
@@ -128,6 +152,14 @@ public:
     }
 
 private:
+    // cached by GetFrustum together with what it was extracted from
+    Frustum frustum;
+    glm::vec3 frustumPosition;
+    glm::vec3 frustumFront;
+    glm::vec3 frustumUp;
+    glm::mat4 frustumProjection;
+    bool frustumValid = false;
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
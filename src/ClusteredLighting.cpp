@@ -0,0 +1,222 @@
+#include "ClusteredLighting.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Light.h"
+#include "UploadRing.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLUSTER_SSE
+#endif
+
+namespace {
+
+	const unsigned int kTilesPerSlice = ClusteredLighting::kTilesX * ClusteredLighting::kTilesY;
+	const unsigned int kClusterCount = kTilesPerSlice * ClusteredLighting::kSlices;
+	// attenuation below which a light counts as faded out
+	const float kCutoff = 1.0f / 256.0f;
+	// lights that never get that dim still end somewhere
+	const float kMaxRadius = 1000.0f;
+	// attenuation of MakePointLight(Light) halfway to the radius is 1 / (1 + kFalloff / 4)
+	const float kFalloff = 25.0f;
+
+	// slice of a view space depth, depths outside near..far land in the first or the last one
+	unsigned int sliceOf(float depth, float nearPlane, float scale) {
+		if (depth <= nearPlane)
+			return 0;
+		float slice = std::log(depth / nearPlane) * scale;
+		return static_cast<unsigned int>(std::min(slice, static_cast<float>(ClusteredLighting::kSlices - 1)));
+	}
+}
+
+ClusteredLighting::PointLight ClusteredLighting::MakePointLight(const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+	float constant, float linear, float quadratic) {
+
+	// constant + linear * d + quadratic * d^2 = 1 / kCutoff
+	float limit = 1.0f / kCutoff - constant;
+	float radius = kMaxRadius;
+	if (quadratic > 0.0f)
+		radius = (-linear + std::sqrt(linear * linear + 4.0f * quadratic * limit)) / (2.0f * quadratic);
+	else if (linear > 0.0f)
+		radius = limit / linear;
+	radius = std::min(std::max(radius, 0.0f), kMaxRadius);
+
+	PointLight light;
+	light.positionRadius = glm::vec4(position, radius);
+	light.ambientConstant = glm::vec4(ambient, constant);
+	light.diffuseLinear = glm::vec4(diffuse, linear);
+	light.specularQuadratic = glm::vec4(specular, quadratic);
+	return light;
+}
+
+ClusteredLighting::PointLight ClusteredLighting::MakePointLight(const Light& light) {
+	float radius = std::max(light.radius, 1e-3f);
+	glm::vec3 color = light.color * light.strength;
+
+	PointLight result;
+	result.positionRadius = glm::vec4(light.position, radius);
+	result.ambientConstant = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	result.diffuseLinear = glm::vec4(color, 0.0f);
+	result.specularQuadratic = glm::vec4(color, kFalloff / (radius * radius));
+	return result;
+}
+
+ClusteredLighting::ClusteredLighting() : boundsProjection(0.0f), maxClusterLights(0) {
+	std::memset(&header, 0, sizeof(header));
+	ranges.assign(kClusterCount * 2, 0);
+}
+
+void ClusteredLighting::buildBounds(const glm::mat4& projection, float nearPlane, float farPlane) {
+	boundsMinX.resize(kClusterCount);
+	boundsMinY.resize(kClusterCount);
+	boundsMinZ.resize(kClusterCount);
+	boundsMaxX.resize(kClusterCount);
+	boundsMaxY.resize(kClusterCount);
+	boundsMaxZ.resize(kClusterCount);
+
+	// a point at view depth d (distance in front of the camera) with NDC x has view x = (x + P[2][0]) * d / P[0][0]
+	float ratio = farPlane / nearPlane;
+	for (unsigned int slice = 0; slice < kSlices; ++slice) {
+		float depths[2] = {
+			nearPlane * std::pow(ratio, static_cast<float>(slice) / kSlices),
+			nearPlane * std::pow(ratio, static_cast<float>(slice + 1) / kSlices)
+		};
+		for (unsigned int y = 0; y < kTilesY; ++y) {
+			float ndcY[2] = { -1.0f + 2.0f * y / kTilesY, -1.0f + 2.0f * (y + 1) / kTilesY };
+			for (unsigned int x = 0; x < kTilesX; ++x) {
+				float ndcX[2] = { -1.0f + 2.0f * x / kTilesX, -1.0f + 2.0f * (x + 1) / kTilesX };
+				unsigned int cluster = (slice * kTilesY + y) * kTilesX + x;
+
+				float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+				for (int d = 0; d < 2; ++d) {
+					for (int e = 0; e < 2; ++e) {
+						float viewX = (ndcX[e] + projection[2][0]) * depths[d] / projection[0][0];
+						float viewY = (ndcY[e] + projection[2][1]) * depths[d] / projection[1][1];
+						minX = std::min(minX, viewX);
+						maxX = std::max(maxX, viewX);
+						minY = std::min(minY, viewY);
+						maxY = std::max(maxY, viewY);
+					}
+				}
+				boundsMinX[cluster] = minX;
+				boundsMaxX[cluster] = maxX;
+				boundsMinY[cluster] = minY;
+				boundsMaxY[cluster] = maxY;
+				// the camera looks down -z
+				boundsMinZ[cluster] = -depths[1];
+				boundsMaxZ[cluster] = -depths[0];
+			}
+		}
+	}
+	boundsProjection = projection;
+}
+
+void ClusteredLighting::intersect(unsigned int light, const glm::vec3& center, float radius, unsigned int firstSlice, unsigned int lastSlice) {
+	unsigned int begin = firstSlice * kTilesPerSlice;
+	unsigned int end = (lastSlice + 1) * kTilesPerSlice;
+
+#ifdef CLUSTER_SSE
+	// distance from the center to each box, four boxes at a time. kTilesPerSlice is a multiple of four
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	const __m128 radiusSquared = _mm_set1_ps(radius * radius);
+	for (unsigned int cluster = begin; cluster < end; cluster += 4) {
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinX[cluster]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&boundsMaxX[cluster]))), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinY[cluster]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&boundsMaxY[cluster]))), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boundsMinZ[cluster]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&boundsMaxZ[cluster]))), zero);
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+		for (unsigned int lane = 0; mask; ++lane, mask >>= 1) {
+			if (mask & 1) {
+				hitClusters.push_back(cluster + lane);
+				hitLights.push_back(light);
+			}
+		}
+	}
+#else
+	float radiusSquared = radius * radius;
+	for (unsigned int cluster = begin; cluster < end; ++cluster) {
+		float dx = std::max(std::max(boundsMinX[cluster] - center.x, center.x - boundsMaxX[cluster]), 0.0f);
+		float dy = std::max(std::max(boundsMinY[cluster] - center.y, center.y - boundsMaxY[cluster]), 0.0f);
+		float dz = std::max(std::max(boundsMinZ[cluster] - center.z, center.z - boundsMaxZ[cluster]), 0.0f);
+		if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+			hitClusters.push_back(cluster);
+			hitLights.push_back(light);
+		}
+	}
+#endif
+}
+
+void ClusteredLighting::Assign(const glm::mat4& view, const glm::mat4& projection, int width, int height, const PointLight* lights, size_t lightCount) {
+	// the planes of a GL perspective projection
+	float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	if (boundsMinX.empty() || projection != boundsProjection)
+		buildBounds(projection, nearPlane, farPlane);
+
+	float sliceScale = kSlices / std::log(farPlane / nearPlane);
+	header.counts[0] = kTilesX;
+	header.counts[1] = kTilesY;
+	header.counts[2] = kSlices;
+	header.counts[3] = static_cast<unsigned int>(lightCount);
+	header.scale[0] = static_cast<float>(kTilesX) / std::max(width, 1);
+	header.scale[1] = static_cast<float>(kTilesY) / std::max(height, 1);
+	header.scale[2] = sliceScale;
+	header.scale[3] = -std::log(nearPlane) * sliceScale;
+	header.depth[0] = nearPlane;
+	header.depth[1] = farPlane;
+
+	this->lights.assign(lights, lights + lightCount);
+	hitClusters.clear();
+	hitLights.clear();
+	for (size_t i = 0; i < lightCount; ++i) {
+		glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].positionRadius), 1.0f));
+		float radius = lights[i].positionRadius.w;
+		float depth = -center.z;
+		if (depth + radius <= nearPlane || depth - radius >= farPlane)
+			continue;
+		unsigned int firstSlice = sliceOf(depth - radius, nearPlane, sliceScale);
+		unsigned int lastSlice = sliceOf(depth + radius, nearPlane, sliceScale);
+		intersect(static_cast<unsigned int>(i), center, radius, firstSlice, lastSlice);
+	}
+
+	// counting sort of the hits by cluster, the lights of a cluster stay in their order
+	std::fill(ranges.begin(), ranges.end(), 0u);
+	for (unsigned int cluster : hitClusters)
+		ranges[cluster * 2 + 1]++;
+	unsigned int offset = 0;
+	maxClusterLights = 0;
+	for (unsigned int cluster = 0; cluster < kClusterCount; ++cluster) {
+		ranges[cluster * 2] = offset;
+		offset += ranges[cluster * 2 + 1];
+		maxClusterLights = std::max(maxClusterLights, ranges[cluster * 2 + 1]);
+		ranges[cluster * 2 + 1] = 0;
+	}
+	indices.resize(hitClusters.size());
+	for (size_t i = 0; i < hitClusters.size(); ++i) {
+		unsigned int cluster = hitClusters[i];
+		indices[ranges[cluster * 2] + ranges[cluster * 2 + 1]++] = hitLights[i];
+	}
+}
+
+void ClusteredLighting::Upload(UploadRing& ring) {
+	// empty ranges can't be bound, the shaders never read past the counts anyway
+	UploadRing::Allocation lightData = ring.AllocateStorage(std::max<size_t>(lights.size(), 1) * sizeof(PointLight));
+	UploadRing::Allocation gridData = ring.AllocateStorage(sizeof(GridHeader) + ranges.size() * sizeof(unsigned int));
+	UploadRing::Allocation indexData = ring.AllocateStorage(std::max<size_t>(indices.size(), 1) * sizeof(unsigned int));
+	if (!lightData.data || !gridData.data || !indexData.data)
+		return;
+
+	if (!lights.empty())
+		std::memcpy(lightData.data, lights.data(), lights.size() * sizeof(PointLight));
+	std::memcpy(gridData.data, &header, sizeof(GridHeader));
+	std::memcpy(static_cast<char*>(gridData.data) + sizeof(GridHeader), ranges.data(), ranges.size() * sizeof(unsigned int));
+	if (!indices.empty())
+		std::memcpy(indexData.data, indices.data(), indices.size() * sizeof(unsigned int));
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kLightBinding, lightData.buffer, lightData.offset, lightData.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kGridBinding, gridData.buffer, gridData.offset, gridData.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kIndexBinding, indexData.buffer, indexData.offset, indexData.size);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+class Light;
+class UploadRing;
+
+// Clustered forward shading of point lights. the view frustum is cut into a grid of clusters (froxels): kTilesX by
+// kTilesY screen tiles and kSlices depth slices, spaced exponentially between the near and the far plane so they stay
+// roughly cube shaped. Assign tests every light's sphere against the view space boxes of the clusters in the slices it
+// reaches and writes a light index list per cluster, Upload hands the lights, the grid and the lists to the shaders as
+// storage buffers. a fragment finds its cluster from gl_FragCoord and only shades the lights listed there, so the cost
+// of a pixel follows the lights around it instead of the lights in the scene (1.color.fs, Surface.fs).
+class ClusteredLighting {
+public:
+	// SSBO bindings of the lights, the grid and the light index lists
+	static const unsigned int kLightBinding = 5;
+	static const unsigned int kGridBinding = 6;
+	static const unsigned int kIndexBinding = 7;
+
+	static const unsigned int kTilesX = 16;
+	static const unsigned int kTilesY = 9;
+	static const unsigned int kSlices = 24;
+
+	// std430 layout of a light in the shaders, the attenuation terms ride in the w components
+	struct PointLight {
+		glm::vec4 positionRadius;
+		glm::vec4 ambientConstant;
+		glm::vec4 diffuseLinear;
+		glm::vec4 specularQuadratic;
+	};
+
+	// a light with constant + linear * d + quadratic * d^2 attenuation, its radius is where that drops below 1/256
+	static PointLight MakePointLight(const glm::vec3& position, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		float constant, float linear, float quadratic);
+	// color times strength, fading out quadratically to the light's radius
+	static PointLight MakePointLight(const Light& light);
+
+	ClusteredLighting();
+	ClusteredLighting(const ClusteredLighting&) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+	// builds the light lists for a frame drawn with view and projection (a perspective one) into a width by height
+	// framebuffer. CPU only, can run on any thread
+	void Assign(const glm::mat4& view, const glm::mat4& projection, int width, int height, const PointLight* lights, size_t lightCount);
+	// writes the result of the last Assign into ring and binds it
+	void Upload(UploadRing& ring);
+
+	size_t GetLightCount() const { return lights.size(); }
+	// light indices over all clusters and the most any cluster got
+	size_t GetIndexCount() const { return indices.size(); }
+	unsigned int GetMaxClusterLights() const { return maxClusterLights; }
+
+private:
+	// std430 layout of the grid header in the shaders
+	struct GridHeader {
+		// kTilesX, kTilesY, kSlices, light count
+		unsigned int counts[4];
+		// gl_FragCoord.xy to tiles, log(depth) to slices
+		float scale[4];
+		// near and far plane
+		float depth[4];
+	};
+
+	// view space bounds of every cluster, component by component so four are tested at once.
+	// index (slice * kTilesY + y) * kTilesX + x
+	std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+	// what the bounds were built for
+	glm::mat4 boundsProjection;
+
+	GridHeader header;
+	std::vector<PointLight> lights;
+	// offset into indices and light count of every cluster
+	std::vector<unsigned int> ranges;
+	std::vector<unsigned int> indices;
+	// cluster and light of every sphere-box hit, sorted into indices by cluster
+	std::vector<unsigned int> hitClusters, hitLights;
+	unsigned int maxClusterLights;
+
+	void buildBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+	// appends the clusters of slices first..last that light touches
+	void intersect(unsigned int light, const glm::vec3& center, float radius, unsigned int firstSlice, unsigned int lastSlice);
+};
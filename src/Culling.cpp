@@ -0,0 +1,200 @@
+#include "Culling.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#endif
+
+void SphereBounds::Clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+}
+
+void SphereBounds::Add(const glm::vec3& center, float r) {
+	x.push_back(center.x);
+	y.push_back(center.y);
+	z.push_back(center.z);
+	radius.push_back(r);
+}
+
+void BoxBounds::Clear() {
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoxBounds::Add(const glm::vec3& minimum, const glm::vec3& maximum) {
+	glm::vec3 center = (minimum + maximum) * 0.5f, extent = (maximum - minimum) * 0.5f;
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+}
+
+void BoxBounds::AddTransformed(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& transform) {
+	glm::vec3 transformedMinimum, transformedMaximum;
+	geometry::transformBox(minimum, maximum, transform, transformedMinimum, transformedMaximum);
+	Add(transformedMinimum, transformedMaximum);
+}
+
+void geometry::transformBox(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& transform, glm::vec3& transformedMinimum, glm::vec3& transformedMaximum) {
+	glm::vec3 center = (minimum + maximum) * 0.5f, extent = (maximum - minimum) * 0.5f;
+	glm::vec3 transformedCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+	// every axis of the new box is spanned by the absolute matrix rows applied to the old half size (Arvo)
+	glm::vec3 transformedExtent(0.0f);
+	for (int column = 0; column < 3; ++column)
+		for (int row = 0; row < 3; ++row)
+			transformedExtent[row] += fabsf(transform[column][row]) * extent[column];
+	transformedMinimum = transformedCenter - transformedExtent;
+	transformedMaximum = transformedCenter + transformedExtent;
+}
+
+bool geometry::preservesAngles(const glm::mat4& transform, float tolerance) {
+	glm::vec3 axes[3] = { glm::vec3(transform[0]), glm::vec3(transform[1]), glm::vec3(transform[2]) };
+	float scale = glm::dot(axes[0], axes[0]);
+	if (scale <= 0.0f)
+		return false;
+	// the axes have to be orthogonal and of the same length, compared relative to the squared scale
+	float limit = tolerance * scale;
+	return fabsf(glm::dot(axes[1], axes[1]) - scale) <= limit && fabsf(glm::dot(axes[2], axes[2]) - scale) <= limit &&
+		fabsf(glm::dot(axes[0], axes[1])) <= limit && fabsf(glm::dot(axes[0], axes[2])) <= limit && fabsf(glm::dot(axes[1], axes[2])) <= limit;
+}
+
+namespace {
+
+	bool sphereVisible(const Frustum& frustum, float x, float y, float z, float radius) {
+		for (const glm::vec4& plane : frustum.planes) {
+			if (plane.x * x + plane.y * y + plane.z * z + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	bool boxVisible(const Frustum& frustum, float x, float y, float z, float ex, float ey, float ez) {
+		for (const glm::vec4& plane : frustum.planes) {
+			float distance = plane.x * x + plane.y * y + plane.z * z + plane.w;
+			float reach = fabsf(plane.x) * ex + fabsf(plane.y) * ey + fabsf(plane.z) * ez;
+			if (distance + reach < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	size_t countMask(int mask) {
+		size_t count = 0;
+		for (; mask; mask &= mask - 1)
+			count++;
+		return count;
+	}
+}
+
+size_t geometry::cullSpheres(const Frustum& frustum, const SphereBounds& spheres, unsigned char* visible) {
+
+	size_t count = spheres.Size(), visibleCount = 0, i = 0;
+	const float* x = spheres.x.data();
+	const float* y = spheres.y.data();
+	const float* z = spheres.z.data();
+	const float* radius = spheres.radius.data();
+
+#if defined(CULLING_AVX)
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(plane.x)), _mm256_mul_ps(py, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; ++lane)
+			visible[i + lane] = (mask >> lane) & 1;
+		visibleCount += countMask(mask);
+	}
+#elif defined(CULLING_SSE)
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for (const glm::vec4& plane : frustum.planes) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++lane)
+			visible[i + lane] = (mask >> lane) & 1;
+		visibleCount += countMask(mask);
+	}
+#endif
+	for (; i < count; ++i) {
+		visible[i] = sphereVisible(frustum, x[i], y[i], z[i], radius[i]) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
+
+size_t geometry::cullBoxes(const Frustum& frustum, const BoxBounds& boxes, unsigned char* visible) {
+
+	size_t count = boxes.Size(), visibleCount = 0, i = 0;
+	const float* x = boxes.centerX.data();
+	const float* y = boxes.centerY.data();
+	const float* z = boxes.centerZ.data();
+	const float* ex = boxes.extentX.data();
+	const float* ey = boxes.extentY.data();
+	const float* ez = boxes.extentZ.data();
+
+#if defined(CULLING_AVX)
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 sx = _mm256_loadu_ps(ex + i), sy = _mm256_loadu_ps(ey + i), sz = _mm256_loadu_ps(ez + i);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& plane : frustum.planes) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(plane.x)), _mm256_mul_ps(py, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			// how far the box reaches towards the plane normal
+			__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, _mm256_set1_ps(fabsf(plane.x))), _mm256_mul_ps(sy, _mm256_set1_ps(fabsf(plane.y)))),
+				_mm256_mul_ps(sz, _mm256_set1_ps(fabsf(plane.z))));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; ++lane)
+			visible[i + lane] = (mask >> lane) & 1;
+		visibleCount += countMask(mask);
+	}
+#elif defined(CULLING_SSE)
+	for (; i + 4 <= count; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 sx = _mm_loadu_ps(ex + i), sy = _mm_loadu_ps(ey + i), sz = _mm_loadu_ps(ez + i);
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for (const glm::vec4& plane : frustum.planes) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			// how far the box reaches towards the plane normal
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(sy, _mm_set1_ps(fabsf(plane.y)))),
+				_mm_mul_ps(sz, _mm_set1_ps(fabsf(plane.z))));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++lane)
+			visible[i + lane] = (mask >> lane) & 1;
+		visibleCount += countMask(mask);
+	}
+#endif
+	for (; i < count; ++i) {
+		visible[i] = boxVisible(frustum, x[i], y[i], z[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/ext/vector_float3.hpp"
+#include "glm/ext/matrix_float4x4.hpp"
+#include "Frustum.h"
+
+// Bounding spheres with one array per component, the layout the culling kernels load four or eight at a time.
+struct SphereBounds {
+	std::vector<float> x, y, z, radius;
+
+	void Clear();
+	void Add(const glm::vec3& center, float r);
+	size_t Size() const { return radius.size(); }
+};
+
+// Axis aligned boxes as center and half size, one array per component.
+struct BoxBounds {
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	void Clear();
+	void Add(const glm::vec3& minimum, const glm::vec3& maximum);
+	// adds the box around minimum..maximum after the transform, see geometry::transformBox
+	void AddTransformed(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& transform);
+	size_t Size() const { return centerX.size(); }
+};
+
+namespace geometry {
+
+	// axis aligned box around minimum..maximum after the transform
+	void transformBox(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& transform, glm::vec3& transformedMinimum, glm::vec3& transformedMaximum);
+
+	// true when the transform keeps angles: rotation, uniform scale and translation, no shear or non-uniform scale.
+	// directions and cones only carry over to another space under such a transform
+	bool preservesAngles(const glm::mat4& transform, float tolerance = 1e-3f);
+
+	// visible[i] becomes 1 for every volume that intersects the frustum and 0 for the others, returns how many are visible.
+	// eight volumes per step with AVX, four with SSE, the frustum planes have to be in the space of the bounds
+	size_t cullSpheres(const Frustum& frustum, const SphereBounds& spheres, unsigned char* visible);
+	size_t cullBoxes(const Frustum& frustum, const BoxBounds& boxes, unsigned char* visible);
+}
@@ -1,37 +1,39 @@
 #include "DynamicSurface.h"
 #include <GL/glew.h>
+#include <cstring>
+#include "UploadRing.h"
 
 DynamicSurface::DynamicSurface() {
 
 	vertexCount = 16;
-	glCreateBuffers(1, &VBO);
 	glCreateVertexArrays(1, &VAO);
-	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, 3 * sizeof(float));
-	glNamedBufferStorage(
-		VBO, 16 * 4 * 3, NULL, GL_DYNAMIC_STORAGE_BIT
-	);
 	//pos: 0
 	glEnableVertexArrayAttrib(VAO, 0);
 	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
 	glVertexArrayAttribBinding(VAO, 0, 0);
 }
 
-void DynamicSurface::build(const std::vector<glm::vec3>& data) {
+void DynamicSurface::build(UploadRing& ring, const std::vector<glm::vec3>& data) {
 
 	vertexCount = static_cast<uint32_t>(data.size());
 
-	std::vector<float> vertices;
+	vertices.clear();
 	vertices.reserve(3 * vertexCount);
 	for (glm::vec3 vertex : data) {
 		vertices.push_back(vertex.x);
 		vertices.push_back(vertex.y);
 		vertices.push_back(vertex.z);
 	}
-	glNamedBufferSubData(VBO, 0, vertices.size() * sizeof(float), vertices.data());
+	UploadRing::Allocation allocation = ring.Allocate(vertices.size() * sizeof(float));
+	if (!allocation.data) {
+		vertexCount = 0;
+		return;
+	}
+	memcpy(allocation.data, vertices.data(), allocation.size);
+	glVertexArrayVertexBuffer(VAO, 0, allocation.buffer, allocation.offset, 3 * sizeof(float));
 
 }
 
 DynamicSurface::~DynamicSurface() {
-	glDeleteBuffers(1, &VBO);
 	glDeleteVertexArrays(1, &VAO);
 }
\ No newline at end of file
@@ -2,12 +2,16 @@
 #include <vector>
 #include "glm/ext/vector_float3.hpp"
 
+class UploadRing;
+
+// the control points are rewritten every frame, build copies them into the frame's part of an UploadRing
+// and points the VAO at them
 class DynamicSurface {
 public:
-	unsigned int VBO, VAO, vertexCount;
+	unsigned int VAO, vertexCount;
 	std::vector<float> vertices;
 
 	DynamicSurface();
-	void build(const std::vector<glm::vec3>& data);
+	void build(UploadRing& ring, const std::vector<glm::vec3>& data);
 	~DynamicSurface();
 };
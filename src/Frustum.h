@@ -0,0 +1,39 @@
+#pragma once
+#include "glm/ext/vector_float3.hpp"
+#include "glm/ext/vector_float4.hpp"
+#include "glm/ext/matrix_float4x4.hpp"
+#include "glm/geometric.hpp"
+
+// View frustum as six inward facing planes (xyz = normal, w = distance), extracted from a clip matrix.
+// planes from projection * view are in world space, from projection * view * model in that model's space.
+struct Frustum {
+	enum { Left, Right, Bottom, Top, Near, Far };
+	glm::vec4 planes[6];
+
+	static Frustum FromMatrix(const glm::mat4& m) {
+		// Gribb/Hartmann: rows of the matrix combined, glm is column major so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		Frustum frustum;
+		frustum.planes[Left] = row3 + row0;
+		frustum.planes[Right] = row3 - row0;
+		frustum.planes[Bottom] = row3 + row1;
+		frustum.planes[Top] = row3 - row1;
+		frustum.planes[Near] = row3 + row2;
+		frustum.planes[Far] = row3 - row2;
+		for (glm::vec4& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const {
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,91 @@
+#include "GeometryArena.h"
+#include <GL/glew.h>
+#include <algorithm>
+
+namespace {
+
+	unsigned int createStorage(size_t bytes) {
+		unsigned int buffer;
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, bytes, NULL, GL_DYNAMIC_STORAGE_BIT);
+		return buffer;
+	}
+
+	// moves the used part of a buffer into a new one with the given capacity
+	unsigned int reallocate(unsigned int buffer, size_t usedBytes, size_t newBytes) {
+		unsigned int grown = createStorage(newBytes);
+		if (usedBytes > 0)
+			glCopyNamedBufferSubData(buffer, grown, 0, 0, usedBytes);
+		glDeleteBuffers(1, &buffer);
+		return grown;
+	}
+}
+
+GeometryArena::GeometryArena(size_t vertexCapacity, size_t indexCapacity)
+	: vertexCount(0), vertexCapacity(std::max<size_t>(vertexCapacity, 1)), indexBytes(0), indexCapacity(std::max<size_t>(indexCapacity, 4)) {
+
+	VBO = createStorage(this->vertexCapacity * sizeof(Vertex));
+	EBO = createStorage(this->indexCapacity);
+	glCreateVertexArrays(1, &VAO);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	// same layout as Mesh::setupMesh
+	//pos: 0, normal: 1, texCoords: 2, tangent: 3, bitangent: 4, bone ids: 5, weights: 6
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+	glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+	glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
+	glVertexArrayAttribFormat(VAO, 3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Tangent));
+	glVertexArrayAttribFormat(VAO, 4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Bitangent));
+	glVertexArrayAttribIFormat(VAO, 5, 4, GL_INT, offsetof(Vertex, m_BoneIDs));
+	glVertexArrayAttribFormat(VAO, 6, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, m_Weights));
+	for (unsigned int attribute = 0; attribute <= 6; ++attribute) {
+		glEnableVertexArrayAttrib(VAO, attribute);
+		glVertexArrayAttribBinding(VAO, attribute, 0);
+	}
+}
+
+GeometryArena::~GeometryArena() {
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+unsigned int GeometryArena::AddVertices(const Vertex* vertices, size_t count) {
+
+	if (vertexCount + count > vertexCapacity)
+		growVertexBuffer(vertexCount + count);
+
+	unsigned int baseVertex = static_cast<unsigned int>(vertexCount);
+	glNamedBufferSubData(VBO, vertexCount * sizeof(Vertex), count * sizeof(Vertex), vertices);
+	vertexCount += count;
+	return baseVertex;
+}
+
+size_t GeometryArena::AddIndices(const void* indices, size_t count, size_t indexSize) {
+
+	size_t offset = (indexBytes + indexSize - 1) / indexSize * indexSize;
+	size_t bytes = count * indexSize;
+	if (offset + bytes > indexCapacity)
+		growIndexBuffer(offset + bytes);
+
+	glNamedBufferSubData(EBO, offset, bytes, indices);
+	indexBytes = offset + bytes;
+	return offset;
+}
+
+void GeometryArena::Bind() const {
+	glBindVertexArray(VAO);
+}
+
+void GeometryArena::growVertexBuffer(size_t requiredVertices) {
+	vertexCapacity = std::max(requiredVertices, vertexCapacity * 2);
+	VBO = reallocate(VBO, vertexCount * sizeof(Vertex), vertexCapacity * sizeof(Vertex));
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
+}
+
+void GeometryArena::growIndexBuffer(size_t requiredBytes) {
+	indexCapacity = std::max(requiredBytes, indexCapacity * 2);
+	EBO = reallocate(EBO, indexBytes, indexCapacity);
+	glVertexArrayElementBuffer(VAO, EBO);
+}
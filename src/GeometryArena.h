@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include "Vertex.h"
+
+// One vertex buffer and one index buffer under a single VAO that many meshes suballocate from.
+// Meshes keep their own indices relative to their first vertex and are drawn with glDrawElementsBaseVertex,
+// so a whole Model (or every model sharing the arena) is drawn with one VAO bind.
+// Allocations are only ever appended, full buffers are grown by copying into larger ones on the GPU.
+class GeometryArena {
+public:
+	unsigned int VAO, VBO, EBO;
+
+	GeometryArena(size_t vertexCapacity = 1 << 16, size_t indexCapacity = 1 << 20);
+	~GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// copies the vertices into the arena, returns the base vertex of the allocation
+	unsigned int AddVertices(const Vertex* vertices, size_t count);
+	// copies the indices into the arena, returns the byte offset of the allocation aligned to indexSize
+	size_t AddIndices(const void* indices, size_t count, size_t indexSize);
+
+	void Bind() const;
+
+	size_t GetVertexCount() const { return vertexCount; }
+	size_t GetIndexBytes() const { return indexBytes; }
+
+private:
+	size_t vertexCount, vertexCapacity;
+	size_t indexBytes, indexCapacity;
+
+	void growVertexBuffer(size_t requiredVertices);
+	void growIndexBuffer(size_t requiredBytes);
+};
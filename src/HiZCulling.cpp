@@ -0,0 +1,147 @@
+#include "HiZCulling.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include "Frustum.h"
+#include "InstanceBuffer.h"
+#include "UploadRing.h"
+
+namespace {
+
+	// same layout as DrawArraysIndirectCommand
+	struct DrawCommand {
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int first;
+		unsigned int baseInstance;
+	};
+
+	const unsigned int kCullGroupSize = 64;
+	const unsigned int kDownsampleGroupSize = 8;
+}
+
+HiZCulling::HiZCulling(unsigned int downsampleProgram, unsigned int cullProgram, size_t capacity)
+	: downsampleProgram(downsampleProgram), cullProgram(cullProgram), instanceBuffer(0), instanceOffset(0), capacity(std::max<size_t>(capacity, 1)), count(0),
+	depthTexture(0), pyramid(0), width(0), height(0), levels(0), pyramidViewProjection(1.0f), pyramidValid(false) {
+
+	glCreateBuffers(1, &visibleBuffer);
+	glCreateBuffers(1, &commandBuffer);
+	glNamedBufferData(visibleBuffer, this->capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+	DrawCommand command = { 0, 0, 0, 0 };
+	glNamedBufferData(commandBuffer, sizeof(DrawCommand), &command, GL_DYNAMIC_DRAW);
+}
+
+HiZCulling::~HiZCulling() {
+	glDeleteBuffers(1, &visibleBuffer);
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &pyramid);
+}
+
+void HiZCulling::SetInstances(UploadRing& ring, const glm::mat4* transforms, const glm::vec4* spheres, size_t count) {
+
+	if (count > capacity) {
+		while (capacity < count)
+			capacity *= 2;
+		// a new name would have to be attached to the VAOs again, the storage of the same name is replaced instead
+		glNamedBufferData(visibleBuffer, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+	}
+	this->count = 0;
+	if (count == 0)
+		return;
+	UploadRing::Allocation allocation = ring.AllocateStorage(count * sizeof(Instance));
+	if (!allocation.data)
+		return;
+	Instance* instances = static_cast<Instance*>(allocation.data);
+	for (size_t i = 0; i < count; ++i) {
+		instances[i].transform = transforms[i];
+		instances[i].sphere = spheres[i];
+	}
+	instanceBuffer = allocation.buffer;
+	instanceOffset = allocation.offset;
+	this->count = count;
+}
+
+void HiZCulling::Cull(const glm::mat4& viewProjection, unsigned int vertexCount) {
+
+	// the shader counts the visible instances up from 0
+	DrawCommand command = { vertexCount, 0, 0, 0 };
+	glNamedBufferSubData(commandBuffer, 0, sizeof(DrawCommand), &command);
+	if (count == 0)
+		return;
+
+	Frustum frustum = Frustum::FromMatrix(viewProjection);
+	glUseProgram(cullProgram);
+	glUniform1ui(glGetUniformLocation(cullProgram, "instanceCount"), static_cast<unsigned int>(count));
+	glUniform4fv(glGetUniformLocation(cullProgram, "planes"), 6, &frustum.planes[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(cullProgram, "pyramidViewProjection"), 1, GL_FALSE, &pyramidViewProjection[0][0]);
+	glUniform1i(glGetUniformLocation(cullProgram, "pyramidValid"), pyramidValid ? 1 : 0);
+	glUniform1i(glGetUniformLocation(cullProgram, "pyramidLevels"), levels);
+	glUniform1i(glGetUniformLocation(cullProgram, "pyramid"), 0);
+	glBindTextureUnit(0, pyramid);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kInstanceBinding, instanceBuffer, instanceOffset, count * sizeof(Instance));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kVisibleBinding, visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandBinding, commandBuffer);
+	glDispatchCompute(static_cast<unsigned int>((count + kCullGroupSize - 1) / kCullGroupSize), 1, 1);
+	// the draw reads the command and the transforms the shader wrote
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void HiZCulling::Draw(unsigned int mode) const {
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glDrawArraysIndirect(mode, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void HiZCulling::Attach(unsigned int vao) const {
+	InstanceBuffer::AttachMatrices(vao, visibleBuffer, 0);
+}
+
+void HiZCulling::resize(int width, int height) {
+
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &pyramid);
+	this->width = width;
+	this->height = height;
+	levels = 1;
+	while ((std::max(width, height) >> levels) > 0)
+		levels++;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glCreateTextures(GL_TEXTURE_2D, 1, &pyramid);
+	glTextureStorage2D(pyramid, levels, GL_R32F, width, height);
+	glTextureParameteri(pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	pyramidValid = false;
+}
+
+void HiZCulling::BuildPyramid(int width, int height, const glm::mat4& viewProjection) {
+
+	if (width <= 0 || height <= 0)
+		return;
+	if (width != this->width || height != this->height)
+		resize(width, height);
+
+	// a depth format texture takes the depth of the read framebuffer
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glCopyTextureSubImage2D(depthTexture, 0, 0, 0, 0, 0, width, height);
+
+	glUseProgram(downsampleProgram);
+	glUniform1i(glGetUniformLocation(downsampleProgram, "depth"), 0);
+	glBindTextureUnit(0, depthTexture);
+	for (int level = 0; level < levels; ++level) {
+		// level 0 copies the depth texture, every other level reduces the one above it
+		glUniform1i(glGetUniformLocation(downsampleProgram, "fromDepth"), level == 0 ? 1 : 0);
+		glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glBindImageTexture(1, pyramid, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+		glDispatchCompute((levelWidth + kDownsampleGroupSize - 1) / kDownsampleGroupSize, (levelHeight + kDownsampleGroupSize - 1) / kDownsampleGroupSize, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	// Cull reads the pyramid through a sampler
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	pyramidViewProjection = viewProjection;
+	pyramidValid = true;
+}
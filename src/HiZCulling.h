@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include "glm/mat4x4.hpp"
+#include "glm/ext/vector_float4.hpp"
+
+class UploadRing;
+
+// Occlusion culling of an instanced batch on the GPU. BuildPyramid copies the depth buffer of a finished frame and
+// reduces it into a mip chain whose texels hold the farthest depth of the area they cover. Cull then runs a compute
+// shader over the instances that tests every bounding sphere against the frustum and against the pyramid, appends
+// the transforms of the visible ones to a buffer read as the instance attribute (see InstanceBuffer) and counts them
+// in the instanceCount of an indirect draw command. nothing is read back, the draw takes the count from the GPU.
+// the pyramid is one frame old, so an instance that comes out from behind an occluder shows up a frame late.
+class HiZCulling {
+public:
+	// SSBO bindings of the culling shader (HiZCull.comp)
+	static const unsigned int kInstanceBinding = 1;
+	static const unsigned int kVisibleBinding = 2;
+	static const unsigned int kCommandBinding = 3;
+
+	// the programs are HiZDownsample.comp and HiZCull.comp
+	HiZCulling(unsigned int downsampleProgram, unsigned int cullProgram, size_t capacity = 64);
+	~HiZCulling();
+	HiZCulling(const HiZCulling&) = delete;
+	HiZCulling& operator=(const HiZCulling&) = delete;
+
+	// transforms of the batch with a world space bounding sphere each (xyz center, w radius), written into the
+	// frame's part of ring
+	void SetInstances(UploadRing& ring, const glm::mat4* transforms, const glm::vec4* spheres, size_t count);
+	// culls the instances for a draw of vertexCount vertices per instance, viewProjection is the one of this frame
+	void Cull(const glm::mat4& viewProjection, unsigned int vertexCount);
+	// glDrawArraysIndirect with the command Cull wrote, the VAO has to have the visible transforms attached
+	void Draw(unsigned int mode) const;
+
+	// sets up the instance attribute of a VAO (see InstanceBuffer) to read the visible transforms
+	void Attach(unsigned int vao) const;
+
+	// copies the depth of the default framebuffer (width x height) after a frame drawn with viewProjection and
+	// rebuilds the pyramid from it
+	void BuildPyramid(int width, int height, const glm::mat4& viewProjection);
+
+private:
+	struct Instance {
+		glm::mat4 transform;
+		glm::vec4 sphere;
+	};
+
+	unsigned int downsampleProgram;
+	unsigned int cullProgram;
+	// range of the ring holding the instances of this frame
+	unsigned int instanceBuffer;
+	size_t instanceOffset;
+	unsigned int visibleBuffer;
+	unsigned int commandBuffer;
+	size_t capacity;
+	size_t count;
+
+	unsigned int depthTexture;
+	unsigned int pyramid;
+	int width, height;
+	int levels;
+	// what the pyramid was rendered with, false until the first BuildPyramid
+	glm::mat4 pyramidViewProjection;
+	bool pyramidValid;
+
+	void resize(int width, int height);
+};
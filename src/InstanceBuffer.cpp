@@ -0,0 +1,61 @@
+#include "InstanceBuffer.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+#include "UploadRing.h"
+
+InstanceBuffer::InstanceBuffer(size_t capacity) : buffer(0), sourceOffset(0), capacity(std::max<size_t>(capacity, 1)), count(0) {
+	glCreateBuffers(1, &buffer);
+	source = buffer;
+	glNamedBufferData(buffer, this->capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	glDeleteBuffers(1, &buffer);
+}
+
+void InstanceBuffer::Upload(const glm::mat4* transforms, size_t count) {
+	while (capacity < count)
+		capacity *= 2;
+	// same name with new storage, attached VAOs keep pointing at it
+	glNamedBufferData(buffer, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	if (count > 0)
+		glNamedBufferSubData(buffer, 0, count * sizeof(glm::mat4), transforms);
+	this->count = count;
+	source = buffer;
+	sourceOffset = 0;
+}
+
+void InstanceBuffer::Upload(UploadRing& ring, const glm::mat4* transforms, size_t count) {
+	this->count = 0;
+	if (count == 0)
+		return;
+	UploadRing::Allocation allocation = ring.Allocate(count * sizeof(glm::mat4));
+	if (!allocation.data)
+		return;
+	memcpy(allocation.data, transforms, allocation.size);
+	this->count = count;
+	source = allocation.buffer;
+	sourceOffset = allocation.offset;
+}
+
+void InstanceBuffer::Attach(unsigned int vao) const {
+	AttachMatrices(vao, source, sourceOffset);
+}
+
+void InstanceBuffer::AttachMatrices(unsigned int vao, unsigned int buffer, size_t offset) {
+	glVertexArrayVertexBuffer(vao, kBindingIndex, buffer, offset, sizeof(glm::mat4));
+	glVertexArrayBindingDivisor(vao, kBindingIndex, 1);
+	// a mat4 attribute takes one location per column
+	for (unsigned int column = 0; column < 4; ++column) {
+		unsigned int location = kFirstLocation + column;
+		glVertexArrayAttribFormat(vao, location, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4));
+		glVertexArrayAttribBinding(vao, location, kBindingIndex);
+		glEnableVertexArrayAttrib(vao, location);
+	}
+}
+
+void InstanceBuffer::Detach(unsigned int vao) const {
+	for (unsigned int column = 0; column < 4; ++column)
+		glDisableVertexArrayAttrib(vao, kFirstLocation + column);
+}
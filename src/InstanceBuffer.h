@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include "glm/mat4x4.hpp"
+
+class UploadRing;
+
+// Per-instance model matrices streamed into a vertex buffer and read as a mat4 attribute (locations
+// kFirstLocation..kFirstLocation + 3, divisor 1), so any number of instances is one instanced draw.
+// Attach hooks the buffer into a VAO for the draw, Detach disables the attributes again so the
+// VAO's non-instanced draws don't fetch from it.
+class InstanceBuffer {
+public:
+	static const unsigned int kFirstLocation = 7;
+	static const unsigned int kBindingIndex = 7;
+
+	explicit InstanceBuffer(size_t capacity = 64);
+	~InstanceBuffer();
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	// replaces the contents with count matrices. the old storage is orphaned, so a draw still reading it doesn't stall the upload
+	void Upload(const glm::mat4* transforms, size_t count);
+	// copies the matrices into the frame's part of ring instead, for batches that change every frame. the data
+	// moves with every upload, Attach the VAO again after it
+	void Upload(UploadRing& ring, const glm::mat4* transforms, size_t count);
+
+	void Attach(unsigned int vao) const;
+	void Detach(unsigned int vao) const;
+	// sets up the instance attribute of vao to read tightly packed matrices from buffer at offset, what Attach does
+	// for the buffer's own data. for matrices written elsewhere, e.g. by HiZCulling
+	static void AttachMatrices(unsigned int vao, unsigned int buffer, size_t offset);
+
+	size_t GetCount() const { return count; }
+
+private:
+	unsigned int buffer;
+	// where the last upload went, buffer or a ring
+	unsigned int source;
+	size_t sourceOffset;
+	size_t capacity;
+	size_t count;
+};
@@ -0,0 +1,209 @@
+#include "JobSystem.h"
+
+namespace {
+
+	const size_t kQueueCapacity = 4096;
+	// rounds a worker looks for jobs before it goes to sleep
+	const int kIdleSpins = 64;
+
+	// the system and slot of the calling thread
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local int currentSlot = -1;
+}
+
+JobSystem::WorkQueue::WorkQueue(size_t capacity) : jobs(new std::atomic<Job*>[capacity]), mask(capacity - 1), top(0), bottom(0) {
+	for (size_t i = 0; i < capacity; ++i)
+		jobs[i].store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobSystem::WorkQueue::Push(Job* job) {
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	if (b - t > static_cast<long long>(mask))
+		return false;
+	jobs[b & mask].store(job, std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_seq_cst);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkQueue::Pop() {
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	// taking the bottom slot has to be visible before top is read, a thief may be going for the same one
+	bottom.store(b, std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_seq_cst);
+	if (t > b) {
+		// empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	Job* job = jobs[b & mask].load(std::memory_order_acquire);
+	if (t == b) {
+		// the last job, whoever moves top first gets it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkQueue::Steal() {
+	long long t = top.load(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_seq_cst);
+	if (t >= b)
+		return nullptr;
+	Job* job = jobs[t & mask].load(std::memory_order_acquire);
+	// lost against the owner or another thief
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+JobSystem::JobSystem(unsigned int threadCount) : injectedCount(0), queued(0), sleeping(0), stopping(false) {
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	// worker 0 only works while it waits, the jobs of other threads need at least one more
+	threadCount = std::max(threadCount, 2u);
+	for (unsigned int worker = 0; worker < threadCount; ++worker)
+		queues.emplace_back(new WorkQueue(kQueueCapacity));
+
+	currentSystem = this;
+	currentSlot = 0;
+	for (unsigned int worker = 1; worker < threadCount; ++worker)
+		threads.emplace_back(&JobSystem::workerLoop, this, worker);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	if (currentSystem == this) {
+		currentSystem = nullptr;
+		currentSlot = -1;
+	}
+}
+
+JobSystem& JobSystem::Get() {
+	static JobSystem system;
+	return system;
+}
+
+int JobSystem::currentWorker() const {
+	return currentSystem == this ? currentSlot : -1;
+}
+
+void JobSystem::schedule(Job* job) {
+	int worker = currentWorker();
+	if (worker >= 0) {
+		// a full deque runs the job right away rather than losing it
+		if (!queues[worker]->Push(job)) {
+			execute(job, worker);
+			return;
+		}
+	}
+	else {
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		injected.push_back(job);
+		injectedCount++;
+	}
+
+	queued++;
+	// a worker checks queued under the lock before it sleeps, so it either sees the job or gets the notification
+	if (sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::findJob(int worker) {
+	Job* job = queues[worker]->Pop();
+	if (!job && injectedCount.load() > 0) {
+		std::lock_guard<std::mutex> lock(injectedMutex);
+		if (!injected.empty()) {
+			job = injected.back();
+			injected.pop_back();
+			injectedCount--;
+		}
+	}
+	// steal from the others, starting with the next worker so thieves spread out
+	for (size_t i = 1; !job && i < queues.size(); ++i)
+		job = queues[(worker + i) % queues.size()]->Steal();
+	if (job)
+		queued--;
+	return job;
+}
+
+void JobSystem::execute(Job* job, unsigned int worker) {
+	job->function(worker);
+
+	Counter* counter = job->counter;
+	delete job;
+	if (!counter)
+		return;
+	std::vector<Job*> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (--counter->pending == 0)
+			released.swap(counter->waiting);
+	}
+	for (Job* waiting : released)
+		schedule(waiting);
+}
+
+void JobSystem::Run(Function function, Counter* counter) {
+	if (counter)
+		counter->pending++;
+	schedule(new Job{ std::move(function), counter });
+}
+
+void JobSystem::RunAfter(Counter& dependency, Function function, Counter* counter) {
+	if (counter)
+		counter->pending++;
+	Job* job = new Job{ std::move(function), counter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending.load() > 0) {
+			dependency.waiting.push_back(job);
+			return;
+		}
+	}
+	schedule(job);
+}
+
+void JobSystem::Wait(Counter& counter) {
+	int worker = currentWorker();
+	while (counter.pending.load() > 0) {
+		Job* job = worker >= 0 ? findJob(worker) : nullptr;
+		if (job)
+			execute(job, worker);
+		else
+			std::this_thread::yield();
+	}
+	// the last job may still be releasing what waited on the counter
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::workerLoop(unsigned int worker) {
+	currentSystem = this;
+	currentSlot = static_cast<int>(worker);
+	int idle = 0;
+	while (!stopping.load()) {
+		Job* job = findJob(worker);
+		if (job) {
+			execute(job, worker);
+			idle = 0;
+		}
+		else if (++idle < kIdleSpins)
+			std::this_thread::yield();
+		else {
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleeping++;
+			wake.wait(lock, [&]() { return stopping.load() || queued.load() > 0; });
+			sleeping--;
+			idle = 0;
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One worker per hardware thread that every parallel task of the program goes through (asset decoding, frame
+// preparation, the occlusion rasterizer). every worker owns a Chase-Lev deque: it pushes and pops its own jobs at
+// the bottom without locking and idle workers steal from the top of the others. the thread that creates the
+// system is worker 0 and only works while it waits, threads outside the system queue their jobs in a shared list.
+// completion is tracked with Counters: Run adds a job to one, Wait runs jobs until it drops to zero, and RunAfter
+// holds a job back until another counter is done. jobs may Run and Wait themselves, a waiting worker keeps
+// running other jobs. none of this makes GL calls safe anywhere but on the thread with the context.
+class JobSystem {
+private:
+	struct Job;
+
+public:
+	// jobs still pending in a group. Run and RunAfter count up, finished jobs count down. a counter has to
+	// outlive its jobs and is reused only after Wait returned on it
+	class Counter {
+	public:
+		Counter() : pending(0) {}
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool IsDone() const { return pending.load() == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<int> pending;
+		// guards pending reaching zero against RunAfter parking jobs on it
+		std::mutex mutex;
+		std::vector<Job*> waiting;
+	};
+
+	typedef std::function<void(unsigned int worker)> Function;
+
+	// threadCount includes the creating thread, 0 takes one per hardware thread. there are always at least two
+	explicit JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// the system of the program, created by the first call. that thread should be the main thread
+	static JobSystem& Get();
+
+	// queues function(worker), counter may be null
+	void Run(Function function, Counter* counter = nullptr);
+	// queues function once dependency is done
+	void RunAfter(Counter& dependency, Function function, Counter* counter = nullptr);
+	// returns once counter is done. a worker runs queued jobs meanwhile, other threads just wait
+	void Wait(Counter& counter);
+
+	// runs work(index, worker) for every index in [0, count) and returns when all are done. the indices are queued
+	// in jobs of grain consecutive ones, 0 splits them into a few jobs per worker
+	template<typename Work>
+	void ParallelFor(size_t count, Work work, size_t grain = 0) {
+		if (count == 0)
+			return;
+		if (grain == 0)
+			grain = std::max<size_t>(count / (GetWorkerCount() * 4), 1);
+		Counter counter;
+		for (size_t begin = 0; begin < count; begin += grain) {
+			size_t end = std::min(count, begin + grain);
+			Run([&work, begin, end](unsigned int worker) {
+				for (size_t i = begin; i < end; ++i)
+					work(i, worker);
+			}, &counter);
+		}
+		Wait(counter);
+	}
+
+	unsigned int GetWorkerCount() const { return static_cast<unsigned int>(queues.size()); }
+
+private:
+	struct Job {
+		Function function;
+		Counter* counter;
+	};
+
+	// Chase-Lev work-stealing deque of fixed capacity. Push and Pop are for the owning worker only, Steal for anyone
+	class WorkQueue {
+	public:
+		explicit WorkQueue(size_t capacity);
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		std::unique_ptr<std::atomic<Job*>[]> jobs;
+		size_t mask;
+		std::atomic<long long> top, bottom;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+
+	// jobs queued by threads that aren't workers
+	std::mutex injectedMutex;
+	std::vector<Job*> injected;
+	std::atomic<size_t> injectedCount;
+
+	// idle workers sleep until something is queued
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued;
+	std::atomic<int> sleeping;
+	std::atomic<bool> stopping;
+
+	void workerLoop(unsigned int worker);
+	// worker slot of the calling thread, -1 outside the system
+	int currentWorker() const;
+	void schedule(Job* job);
+	Job* findJob(int worker);
+	void execute(Job* job, unsigned int worker);
+};
@@ -4,4 +4,5 @@ Light::Light(LightCreateInfo* createInfo) {
 	this->position = createInfo->position;
 	this->color = createInfo->color;
 	this->strength = createInfo->strength;
+	this->radius = createInfo->radius;
 }
\ No newline at end of file
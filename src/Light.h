@@ -3,11 +3,13 @@
 struct LightCreateInfo {
 	glm::vec3 position, color;
 	float strength;
+	// distance at which the light has faded out, nothing further away is lit by it
+	float radius;
 };
 
 class Light {
 public:
 	glm::vec3 position, color;
-	float strength;
+	float strength, radius;
 	Light(LightCreateInfo* createInfo);
 };
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "Lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+	const size_t kMinMatch = 4;
+	// the last 5 bytes are always literals and the last match starts at least 12 bytes before the end (LZ4 block rules)
+	const size_t kLastLiterals = 5;
+	const size_t kMatchStartLimit = 12;
+	const size_t kMaxOffset = 65535;
+	const unsigned int kHashBits = 16;
+
+	uint32_t read32(const uint8_t* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - kHashBits);
+	}
+
+	// writes the remainder of a length that didn't fit into its token nibble
+	bool writeLength(uint8_t*& op, const uint8_t* end, size_t length) {
+		for (; length >= 255; length -= 255) {
+			if (op == end)
+				return false;
+			*op++ = 255;
+		}
+		if (op == end)
+			return false;
+		*op++ = uint8_t(length);
+		return true;
+	}
+
+	bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+		uint8_t byte;
+		do {
+			if (ip == end)
+				return false;
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool writeSequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+		if (op == end)
+			return false;
+		uint8_t* token = op++;
+		*token = uint8_t((literalLength < 15 ? literalLength : 15) << 4);
+		if (literalLength >= 15 && !writeLength(op, end, literalLength - 15))
+			return false;
+		if (size_t(end - op) < literalLength)
+			return false;
+		memcpy(op, literals, literalLength);
+		op += literalLength;
+
+		// the last sequence of a block has literals only
+		if (matchLength == 0)
+			return true;
+		if (end - op < 2)
+			return false;
+		*op++ = uint8_t(offset);
+		*op++ = uint8_t(offset >> 8);
+		matchLength -= kMinMatch;
+		*token |= uint8_t(matchLength < 15 ? matchLength : 15);
+		return matchLength < 15 || writeLength(op, end, matchLength - 15);
+	}
+}
+
+size_t lz4::compressBound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+size_t lz4::compress(char* destination, size_t capacity, const char* source, size_t size) {
+
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(source);
+	const uint8_t* ip = base;
+	const uint8_t* anchor = base;
+	const uint8_t* end = base + size;
+	uint8_t* op = reinterpret_cast<uint8_t*>(destination);
+	uint8_t* outputEnd = op + capacity;
+
+	if (size > kMatchStartLimit) {
+		const uint8_t* matchStartLimit = end - kMatchStartLimit;
+		const uint8_t* matchEndLimit = end - kLastLiterals;
+		// positions + 1, so 0 means empty
+		std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+
+		while (ip < matchStartLimit) {
+			uint32_t sequence = read32(ip);
+			uint32_t& slot = table[hash(sequence)];
+			const uint8_t* match = slot ? base + slot - 1 : nullptr;
+			slot = uint32_t(ip - base) + 1;
+
+			if (!match || size_t(ip - match) > kMaxOffset || read32(match) != sequence) {
+				// step faster through data that doesn't compress, like the already compressed images
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			while (ip > anchor && match > base && ip[-1] == match[-1]) {
+				ip--;
+				match--;
+			}
+			const uint8_t* matchEnd = ip + kMinMatch;
+			const uint8_t* reference = match + kMinMatch;
+			while (matchEnd < matchEndLimit && *matchEnd == *reference) {
+				matchEnd++;
+				reference++;
+			}
+
+			if (!writeSequence(op, outputEnd, anchor, size_t(ip - anchor), size_t(ip - match), size_t(matchEnd - ip)))
+				return 0;
+			ip = anchor = matchEnd;
+			// the position just before the next search helps runs of repeated data
+			if (ip - 2 > base)
+				table[hash(read32(ip - 2))] = uint32_t(ip - 2 - base) + 1;
+		}
+	}
+
+	if (!writeSequence(op, outputEnd, anchor, size_t(end - anchor), 0, 0))
+		return 0;
+	return size_t(op - reinterpret_cast<uint8_t*>(destination));
+}
+
+bool lz4::decompress(char* destination, size_t size, const char* source, size_t sourceSize) {
+
+	const uint8_t* ip = reinterpret_cast<const uint8_t*>(source);
+	const uint8_t* end = ip + sourceSize;
+	uint8_t* output = reinterpret_cast<uint8_t*>(destination);
+	uint8_t* op = output;
+	uint8_t* outputEnd = output + size;
+
+	while (ip < end) {
+		uint8_t token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(ip, end, literalLength))
+			return false;
+		if (size_t(end - ip) < literalLength || size_t(outputEnd - op) < literalLength)
+			return false;
+		memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+		size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+		ip += 2;
+		if (offset == 0 || offset > size_t(op - output))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(ip, end, matchLength))
+			return false;
+		matchLength += kMinMatch;
+		if (size_t(outputEnd - op) < matchLength)
+			return false;
+
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength) {
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else {
+			// overlapping copy repeats the last offset bytes
+			for (size_t i = 0; i < matchLength; ++i)
+				*op++ = *match++;
+		}
+	}
+	return op == outputEnd;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+// LZ4 block format (no frame header or checksums), used for the entries of .pak archives.
+// the compressor is the simple greedy single-hash variant: fast and compatible with any LZ4 block decoder.
+namespace lz4 {
+
+	// largest compressed size of size input bytes
+	size_t compressBound(size_t size);
+
+	// returns the compressed size, or 0 when it doesn't fit into capacity
+	size_t compress(char* destination, size_t capacity, const char* source, size_t size);
+
+	// decodes exactly size bytes, returns false for corrupt or truncated input without touching memory outside either buffer
+	bool decompress(char* destination, size_t size, const char* source, size_t sourceSize);
+}
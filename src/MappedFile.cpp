@@ -0,0 +1,132 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	// IsOpen needs a non-null pointer for empty files, which can't be mapped
+	const char emptyFile[1] = { 0 };
+}
+
+MappedFile::MappedFile() : data(nullptr), size(0), file(0), mapping(0) {
+}
+
+MappedFile::MappedFile(const std::string& path) : MappedFile() {
+	Open(path);
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+	if (this != &other) {
+		Close();
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize)) {
+		CloseHandle(handle);
+		return false;
+	}
+	if (fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		data = emptyFile;
+		return true;
+	}
+
+	HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* address = view ? MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!address) {
+		if (view)
+			CloseHandle(view);
+		CloseHandle(handle);
+		return false;
+	}
+
+	data = static_cast<const char*>(address);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	file = reinterpret_cast<intptr_t>(handle);
+	mapping = reinterpret_cast<intptr_t>(view);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data && data != emptyFile) {
+		UnmapViewOfFile(data);
+		CloseHandle(reinterpret_cast<HANDLE>(mapping));
+		CloseHandle(reinterpret_cast<HANDLE>(file));
+	}
+	data = nullptr;
+	size = 0;
+	file = mapping = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0) {
+		close(descriptor);
+		return false;
+	}
+	if (status.st_size == 0) {
+		close(descriptor);
+		data = emptyFile;
+		return true;
+	}
+
+	void* address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (address == MAP_FAILED)
+		return false;
+	madvise(address, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	data = static_cast<const char*>(address);
+	size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data && data != emptyFile)
+		munmap(const_cast<char*>(data), size);
+	data = nullptr;
+	size = 0;
+	file = mapping = 0;
+}
+
+#endif
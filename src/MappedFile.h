@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file (CreateFileMapping on Windows, mmap elsewhere).
+// The contents stay valid until Close or destruction, an empty file maps to a valid zero sized range.
+class MappedFile {
+public:
+	MappedFile();
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	const char* data;
+	size_t size;
+	// file and mapping handles on Windows, the descriptor is closed right after mmap elsewhere
+	intptr_t file;
+	intptr_t mapping;
+};
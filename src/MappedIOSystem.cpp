@@ -0,0 +1,64 @@
+#include "MappedIOSystem.h"
+#include <cstring>
+
+namespace {
+
+	// keeps the mapping alive while ASSIMP reads, even after the file dropped out of the cache
+	class MappedIOStream : public Assimp::MemoryIOStream {
+	public:
+		explicit MappedIOStream(const std::shared_ptr<AssetFile>& file)
+			: MemoryIOStream(reinterpret_cast<const uint8_t*>(file->GetData()), file->GetSize()), file(file) {
+		}
+
+	private:
+		std::shared_ptr<AssetFile> file;
+	};
+}
+
+MappedIOSystem::MappedIOSystem(size_t cacheSize) : cacheSize(cacheSize > 0 ? cacheSize : 1) {
+}
+
+MappedIOSystem::~MappedIOSystem() {
+}
+
+bool MappedIOSystem::Exists(const char* file) const {
+	return acquire(file) != nullptr;
+}
+
+char MappedIOSystem::getOsSeparator() const {
+#ifdef _WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* file, const char* mode) {
+	if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+		return nullptr;
+	std::shared_ptr<AssetFile> mapped = acquire(file);
+	return mapped ? new MappedIOStream(mapped) : nullptr;
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream) {
+	delete stream;
+}
+
+std::shared_ptr<AssetFile> MappedIOSystem::acquire(const std::string& path) const {
+
+	for (size_t i = 0; i < cache.size(); ++i) {
+		if (cache[i].path == path) {
+			std::rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+			return cache[0].file;
+		}
+	}
+
+	std::shared_ptr<AssetFile> file = std::make_shared<AssetFile>();
+	if (!file->Open(path))
+		return nullptr;
+	if (cache.size() == cacheSize)
+		cache.pop_back();
+	CachedFile entry = { path, file };
+	cache.insert(cache.begin(), entry);
+	return file;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <assimp/IOSystem.hpp>
+#include <assimp/MemoryIOWrapper.h>
+#include "AssetFile.h"
+
+// ASSIMP file system that reads through memory mapped files instead of stdio, so parsing is a plain memory scan.
+// files come from the mounted pack archive when it has them, see AssetFile.
+// the last few mapped files are kept open, which serves the Exists/Open pairs ASSIMP issues and repeated
+// material library lookups without reopening the file. read only: opening for writing fails.
+class MappedIOSystem : public Assimp::IOSystem {
+public:
+	explicit MappedIOSystem(size_t cacheSize = 8);
+	~MappedIOSystem() override;
+
+	bool Exists(const char* file) const override;
+	char getOsSeparator() const override;
+	Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+	void Close(Assimp::IOStream* stream) override;
+
+private:
+	struct CachedFile {
+		std::string path;
+		std::shared_ptr<AssetFile> file;
+	};
+	// most recently used first
+	mutable std::vector<CachedFile> cache;
+	size_t cacheSize;
+
+	std::shared_ptr<AssetFile> acquire(const std::string& path) const;
+};
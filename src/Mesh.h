@@ -3,34 +3,37 @@
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <algorithm>
 #include "glm/ext/vector_float3.hpp"
 #include "glm/ext/vector_float2.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/matrix.hpp"
 #include "Shader.h"
+#include "Frustum.h"
+#include "Culling.h"
+#include "Meshlet.h"
+#include "Vertex.h"
+#include "GeometryArena.h"
+#include "MultiDrawBatch.h"
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    // GL_TEXTURE_2D_ARRAY when the texture was packed into a layer of an array shared with other textures
+    GLenum target = GL_TEXTURE_2D;
+    unsigned int layer = 0;
+};
+
+// a level of detail is a range of the index buffer, all levels of a mesh share its vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // largest deviation from the full detail surface, in model space units
+    float error;
 };
 
 class Mesh {
@@ -40,13 +43,46 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // GL_UNSIGNED_SHORT when every index fits into 16 bits, GL_UNSIGNED_INT otherwise
+    GLenum indexType;
+    // levels of detail, level 0 is the full mesh. Draw renders currentLod
+    vector<MeshLod> lods;
+    unsigned int currentLod = 0;
+    // bounding sphere and axis aligned box in the space of the mesh's vertices
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // clusters of the full detail level for DrawClusters, each one is a range of it
+    vector<Meshlet> meshlets;
+    // shared buffers the mesh is suballocated from, nullptr when it owns its VAO/VBO/EBO.
+    // VAO is the arena's then, indices stay relative to the mesh and are offset by baseVertex when drawn
+    GeometryArena* arena;
+    int baseVertex = 0;
+    size_t indexByteOffset = 0;
+    // node of Model::nodes the mesh is attached to, its world matrix places the mesh in model space
+    int node = 0;
+    // has bone weights, the bone palette places it in model space instead of its node
+    bool skinned = false;
+    // positions and triangles of a level of detail kept for the CPU occlusion rasterizer, see Model::RenderOccluders
+    vector<glm::vec3> occluderPositions;
+    vector<unsigned int> occluderIndices;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, without lods the whole index buffer is the only level.
+    // the data is taken over by moving, callers that std::move their vectors in don't copy any vertex
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<MeshLod> lods = vector<MeshLod>(),
+        vector<Meshlet> meshlets = vector<Meshlet>(), GeometryArena* arena = nullptr)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->lods = std::move(lods);
+        this->meshlets = std::move(meshlets);
+        this->arena = arena;
+        if (this->lods.empty())
+            this->lods.push_back({ 0, static_cast<unsigned int>(this->indices.size()), 0.0f });
+
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -54,6 +90,181 @@ public:
 
     // render the mesh
     void Draw(Shader& shader)
+    {
+        glBindVertexArray(VAO);
+        Submit(shader);
+        glBindVertexArray(0);
+    }
+
+    // render only the clusters that can be visible: inside the frustum and not entirely facing away from the camera.
+    // clusters exist for the full detail level only, the other levels are drawn whole.
+    void DrawClusters(Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+    {
+        // cull in model space. the normal cones only hold there under rotation, uniform scale and translation,
+        // a non-uniformly scaled or sheared mesh is culled against the frustum alone
+        Frustum frustum = Frustum::FromMatrix(viewProjection * model);
+        glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+        glBindVertexArray(VAO);
+        SubmitClusters(shader, frustum, eye, geometry::preservesAngles(model));
+        glBindVertexArray(0);
+    }
+
+    // frees the CPU copies of vertices and indices, the GPU buffers, lods, meshlets and bounds are all drawing needs
+    void ReleaseCpuData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // copies the triangles of a level of detail and only the positions they use into occluderPositions/Indices,
+    // before ReleaseCpuData
+    void KeepOccluder(unsigned int level)
+    {
+        const MeshLod& lod = lods[std::min<size_t>(level, lods.size() - 1)];
+        vector<unsigned int> remap(vertices.size(), ~0u);
+        occluderPositions.clear();
+        occluderIndices.resize(lod.indexCount);
+        for (unsigned int i = 0; i < lod.indexCount; i++)
+        {
+            unsigned int vertex = indices[lod.indexOffset + i];
+            if (remap[vertex] == ~0u)
+            {
+                remap[vertex] = static_cast<unsigned int>(occluderPositions.size());
+                occluderPositions.push_back(vertices[vertex].Position);
+            }
+            occluderIndices[i] = remap[vertex];
+        }
+    }
+
+    // true when both meshes bind the same textures to the same units, so drawing one after the other
+    // only needs the layer uniforms of texture arrays updated
+    bool SharesTextureBindings(const Mesh& other) const
+    {
+        if (textures.size() != other.textures.size())
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            if (textures[i].id != other.textures[i].id || textures[i].target != other.textures[i].target || textures[i].type != other.textures[i].type)
+                return false;
+        }
+        return true;
+    }
+
+    // draw calls without the VAO bind, for callers that bind the shared arena VAO once for many meshes.
+    // without bindUnits the textures of the previous mesh (see SharesTextureBindings) are reused. returns whether anything was drawn
+    bool Submit(Shader& shader, bool bindUnits = true)
+    {
+        bindTextures(shader, bindUnits);
+
+        // draw mesh
+        const MeshLod& lod = lods[currentLod];
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, indexType, (void*)(indexByteOffset + lod.indexOffset * indexSize()), baseVertex);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+        return true;
+    }
+
+    // draws instanceCount copies of the current level, the per-instance data comes from the VAO (see InstanceBuffer)
+    bool SubmitInstanced(Shader& shader, GLsizei instanceCount, bool bindUnits = true)
+    {
+        if (instanceCount <= 0)
+            return false;
+        bindTextures(shader, bindUnits);
+
+        const MeshLod& lod = lods[currentLod];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, indexType, (void*)(indexByteOffset + lod.indexOffset * indexSize()),
+            instanceCount, baseVertex);
+
+        glActiveTexture(GL_TEXTURE0);
+        return true;
+    }
+
+    // frustum and eye are in the space of the mesh, see DrawClusters. facingTest false skips the normal cones
+    bool SubmitClusters(Shader& shader, const Frustum& frustum, const glm::vec3& eye, bool facingTest, bool bindUnits = true)
+    {
+        if (meshlets.empty() || currentLod != 0)
+            return Submit(shader, bindUnits);
+
+        clusterCounts.clear();
+        clusterOffsets.clear();
+        unsigned int rangeEnd = ~0u;
+        for (unsigned int i = 0; i < meshlets.size(); i++)
+        {
+            const Meshlet& meshlet = meshlets[i];
+            if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius))
+                continue;
+            if (facingTest && glm::dot(glm::normalize(meshlet.coneApex - eye), meshlet.coneAxis) >= meshlet.coneCutoff)
+                continue;
+
+            // neighbouring visible clusters are merged into one range
+            if (meshlet.indexOffset == rangeEnd)
+                clusterCounts.back() += meshlet.triangleCount * 3;
+            else
+            {
+                clusterCounts.push_back(meshlet.triangleCount * 3);
+                clusterOffsets.push_back((void*)(indexByteOffset + meshlet.indexOffset * indexSize()));
+            }
+            rangeEnd = meshlet.indexOffset + meshlet.triangleCount * 3;
+        }
+        if (clusterCounts.empty())
+            return false;
+
+        bindTextures(shader, bindUnits);
+        clusterBaseVertices.assign(clusterCounts.size(), baseVertex);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, clusterCounts.data(), indexType, clusterOffsets.data(),
+            static_cast<GLsizei>(clusterCounts.size()), clusterBaseVertices.data());
+        glActiveTexture(GL_TEXTURE0);
+        return true;
+    }
+
+    // queues the current level of detail into batch as one indirect draw placed by model. material is the mesh
+    // whose textures the batch binds for it (see BindMaterial), texture array layers go into the draw data
+    void AppendDraw(MultiDrawBatch& batch, const Mesh& material, const glm::mat4& model) const
+    {
+        MultiDrawBatch::DrawData data;
+        data.model = model;
+        const char* types[4] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+        for (unsigned int slot = 0; slot < 4; slot++)
+        {
+            data.layers[slot] = 0;
+            for (unsigned int i = 0; i < textures.size(); i++)
+            {
+                if (textures[i].type == types[slot])
+                {
+                    data.layers[slot] = textures[i].layer;
+                    break;
+                }
+            }
+        }
+        const MeshLod& lod = lods[currentLod];
+        batch.Add(&material, indexType, lod.indexCount, indexByteOffset + lod.indexOffset * indexSize(), baseVertex, data);
+    }
+
+    // binds the textures of the mesh for the draws of a MultiDrawBatch
+    void BindMaterial(Shader& shader)
+    {
+        bindTextures(shader);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    // visible cluster ranges, kept around so culling doesn't allocate every frame
+    vector<GLsizei> clusterCounts;
+    vector<void*> clusterOffsets;
+    vector<GLint> clusterBaseVertices;
+
+    size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    }
+
+    // binds the textures to consecutive units and points the samplers of the shader at them.
+    // the layer of a texture array goes to the int uniform <sampler>_layer, which is all that's set without bindUnits
+    void bindTextures(Shader& shader, bool bindUnits = true)
     {
         // bind appropriate textures
         unsigned int diffuseNr = 1;
@@ -62,7 +273,6 @@ public:
         unsigned int heightNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,28 +285,50 @@ public:
             else if (name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
+            if (textures[i].target == GL_TEXTURE_2D_ARRAY)
+                glUniform1i(glGetUniformLocation(shader.ID, (name + number + "_layer").c_str()), textures[i].layer);
+            if (!bindUnits)
+                continue;
+
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // now set the sampler to the correct texture unit
             glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
             // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            glBindTexture(textures[i].target, textures[i].id);
         }
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // sphere around the center of the axis aligned bounding box, tighter than the average-centered one for most models
+    void computeBounds()
+    {
+        boundsCenter = glm::vec3(0.0f);
+        boundsRadius = 0.0f;
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        if (vertices.empty())
+            return;
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+        for (unsigned int i = 1; i < vertices.size(); i++)
+        {
+            minimum = glm::min(minimum, vertices[i].Position);
+            maximum = glm::max(maximum, vertices[i].Position);
+        }
+        boundsMin = minimum;
+        boundsMax = maximum;
+        boundsCenter = (minimum + maximum) * 0.5f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            boundsRadius = glm::max(boundsRadius, glm::length(vertices[i].Position - boundsCenter));
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        if (arena)
+        {
+            setupArena();
+            return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -110,8 +342,19 @@ private:
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
+        // meshes with fewer than 65536 vertices only need 16 bit indices, which halves the index memory
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        if (vertices.size() < 65536)
+        {
+            vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), &shortIndices[0], GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        }
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -138,5 +381,26 @@ private:
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
     }
+
+    // suballocates vertices and indices from the arena instead of creating own buffers
+    void setupArena()
+    {
+        VAO = arena->VAO;
+        VBO = EBO = 0;
+        baseVertex = static_cast<int>(arena->AddVertices(&vertices[0], vertices.size()));
+
+        // indices are relative to the mesh, so small meshes keep 16 bit indices inside a large arena
+        if (vertices.size() < 65536)
+        {
+            vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            indexByteOffset = arena->AddIndices(&shortIndices[0], shortIndices.size(), sizeof(unsigned short));
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            indexByteOffset = arena->AddIndices(&indices[0], indices.size(), sizeof(unsigned int));
+        }
+    }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,409 @@
+#include "MeshOptimizer.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	// Forsyth's scoring constants, see "Linear-Speed Vertex Cache Optimisation"
+	const int kCacheSize = 32;
+	const float kCacheDecayPower = 1.5f;
+	const float kLastTriScore = 0.75f;
+	const float kValenceBoostScale = 2.0f;
+	const float kValenceBoostPower = 0.5f;
+	const unsigned int kMaxValence = 64;
+
+	// cache size used to split the index buffer into clusters for overdraw optimization
+	const unsigned int kOverdrawCacheSize = 16;
+
+	struct VertexScoreTable {
+		float cache[kCacheSize];
+		float valence[kMaxValence];
+
+		VertexScoreTable() {
+			for (int i = 0; i < kCacheSize; ++i) {
+				if (i < 3)
+					cache[i] = kLastTriScore;
+				else
+					cache[i] = powf(1.0f - float(i - 3) / float(kCacheSize - 3), kCacheDecayPower);
+			}
+			valence[0] = 0.0f;
+			for (unsigned int i = 1; i < kMaxValence; ++i)
+				valence[i] = kValenceBoostScale * powf(float(i), -kValenceBoostPower);
+		}
+
+		float score(int cachePosition, unsigned int remainingValence) const {
+			// vertices without remaining triangles don't contribute to anything
+			if (remainingValence == 0)
+				return 0.0f;
+			float result = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+			return result + valence[std::min(remainingValence, kMaxValence - 1)];
+		}
+	};
+
+	// returns the number of cache misses for the triangle, cache is modelled with per-vertex timestamps
+	unsigned int updateCache(unsigned int a, unsigned int b, unsigned int c, unsigned int cacheSize, unsigned int* timestamps, unsigned int& timestamp) {
+		unsigned int misses = 0;
+		const unsigned int vertices[3] = { a, b, c };
+		for (unsigned int v : vertices) {
+			if (timestamp - timestamps[v] > cacheSize) {
+				timestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+		return misses;
+	}
+
+	void resetCache(unsigned int cacheSize, unsigned int& timestamp) {
+		// moving the clock forward by more than the cache size evicts everything
+		timestamp += cacheSize + 1;
+	}
+
+	// vertex hashing for welding, floats inside the tolerance range are hashed by their epsilon grid cell
+	struct VertexHasher {
+		const char* vertices;
+		size_t vertexSize;
+		size_t toleranceFloats;
+		float epsilon;
+
+		size_t hash(unsigned int index) const {
+			const char* vertex = vertices + index * vertexSize;
+			// FNV-1a over 32 bit words
+			unsigned int h = 2166136261u;
+			size_t words = vertexSize / sizeof(unsigned int);
+			for (size_t i = 0; i < words; ++i) {
+				unsigned int word;
+				if (i < toleranceFloats && epsilon > 0.0f) {
+					float value;
+					memcpy(&value, vertex + i * sizeof(float), sizeof(float));
+					word = unsigned(int(floorf(value / epsilon + 0.5f)));
+				}
+				else {
+					memcpy(&word, vertex + i * sizeof(unsigned int), sizeof(unsigned int));
+				}
+				h = (h ^ word) * 16777619u;
+			}
+			for (size_t i = words * sizeof(unsigned int); i < vertexSize; ++i)
+				h = (h ^ (unsigned char)vertex[i]) * 16777619u;
+			return h;
+		}
+
+		bool equal(unsigned int a, unsigned int b) const {
+			const char* va = vertices + a * vertexSize;
+			const char* vb = vertices + b * vertexSize;
+			if (epsilon <= 0.0f || toleranceFloats == 0)
+				return memcmp(va, vb, vertexSize) == 0;
+
+			for (size_t i = 0; i < toleranceFloats; ++i) {
+				float fa, fb;
+				memcpy(&fa, va + i * sizeof(float), sizeof(float));
+				memcpy(&fb, vb + i * sizeof(float), sizeof(float));
+				if (fabsf(fa - fb) > epsilon)
+					return false;
+			}
+			size_t tail = toleranceFloats * sizeof(float);
+			return memcmp(va + tail, vb + tail, vertexSize - tail) == 0;
+		}
+	};
+}
+
+VertexCacheStatistics geometry::analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+
+	VertexCacheStatistics result = {};
+	if (indexCount < 3 || vertexCount == 0)
+		return result;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int timestamp = cacheSize + 1;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+		result.verticesTransformed += updateCache(indices[i], indices[i + 1], indices[i + 2], cacheSize, timestamps.data(), timestamp);
+
+	result.acmr = float(result.verticesTransformed) / float(indexCount / 3);
+	result.atvr = float(result.verticesTransformed) / float(vertexCount);
+	return result;
+}
+
+void geometry::optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+
+	static const VertexScoreTable table;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangle adjacency per vertex, stored as one array with per-vertex offsets
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; ++t)
+		for (int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = unsigned(t);
+
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = table.score(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; ++t)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	// the cache holds up to three vertices more than kCacheSize while it is being rebuilt
+	unsigned int cache[kCacheSize + 3], newCache[kCacheSize + 3];
+	unsigned int cacheCount = 0;
+
+	// input order cursor, used to restart when no cached vertex has triangles left
+	size_t inputCursor = 0;
+	unsigned int best = unsigned(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	for (size_t output = 0; output < triangleCount; ++output) {
+
+		if (best == ~0u) {
+			while (emitted[inputCursor])
+				inputCursor++;
+			best = unsigned(inputCursor);
+		}
+
+		const unsigned int* tri = &indices[best * 3];
+		destination[output * 3 + 0] = tri[0];
+		destination[output * 3 + 1] = tri[1];
+		destination[output * 3 + 2] = tri[2];
+		emitted[best] = 1;
+
+		// remove the triangle from the adjacency of its vertices
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int i = 0; i < remaining[v]; ++i) {
+				if (list[i] == best) {
+					list[i] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// push the triangle vertices to the front of the LRU cache
+		unsigned int newCount = 0;
+		newCache[newCount++] = tri[0];
+		newCache[newCount++] = tri[1];
+		newCache[newCount++] = tri[2];
+		for (unsigned int i = 0; i < cacheCount; ++i) {
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// rescore everything that was touched, vertices pushed out of the cache lose their cache bonus
+		for (unsigned int i = 0; i < newCount; ++i) {
+			unsigned int v = newCache[i];
+			int position = i < unsigned(kCacheSize) ? int(i) : -1;
+
+			float score = table.score(position, remaining[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; ++j)
+				triangleScore[list[j]] += delta;
+		}
+
+		// the next triangle is the best one that shares a vertex with the cache
+		cacheCount = std::min(newCount, unsigned(kCacheSize));
+		best = ~0u;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cacheCount; ++i) {
+			unsigned int v = newCache[i];
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; ++j) {
+				if (triangleScore[list[j]] > bestScore) {
+					bestScore = triangleScore[list[j]];
+					best = list[j];
+				}
+			}
+		}
+
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+}
+
+void geometry::optimizeOverdraw(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+	const float* positions, size_t vertexCount, size_t positionStride, float threshold) {
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	size_t stride = positionStride / sizeof(float);
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int timestamp = kOverdrawCacheSize + 1;
+
+	// hard boundaries: a triangle that misses the cache with all three vertices starts a disjoint patch
+	std::vector<unsigned int> hard;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		unsigned int misses = updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], kOverdrawCacheSize, timestamps.data(), timestamp);
+		if (t == 0 || misses == 3)
+			hard.push_back(unsigned(t));
+	}
+
+	// soft boundaries: split every patch as soon as the running ACMR is within threshold of the patch ACMR
+	std::vector<unsigned int> clusters;
+	for (size_t c = 0; c < hard.size(); ++c) {
+		unsigned int start = hard[c];
+		unsigned int end = c + 1 < hard.size() ? hard[c + 1] : unsigned(triangleCount);
+
+		resetCache(kOverdrawCacheSize, timestamp);
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; ++t)
+			clusterMisses += updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], kOverdrawCacheSize, timestamps.data(), timestamp);
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		size_t clusterStart = clusters.size();
+		clusters.push_back(start);
+
+		resetCache(kOverdrawCacheSize, timestamp);
+		unsigned int runningMisses = 0, runningTriangles = 0;
+		for (unsigned int t = start; t < end; ++t) {
+			runningMisses += updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], kOverdrawCacheSize, timestamps.data(), timestamp);
+			runningTriangles++;
+			if (float(runningMisses) / float(runningTriangles) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				resetCache(kOverdrawCacheSize, timestamp);
+				runningMisses = runningTriangles = 0;
+			}
+		}
+
+		// the last split either produced an empty cluster or left a poor tail behind, merge it into its predecessor
+		if (clusters.size() - clusterStart > 1)
+			clusters.pop_back();
+	}
+
+	// mesh centroid over the referenced vertices
+	double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < triangleCount * 3; ++i) {
+		const float* p = positions + indices[i] * stride;
+		meshCentroid[0] += p[0];
+		meshCentroid[1] += p[1];
+		meshCentroid[2] += p[2];
+	}
+	for (double& m : meshCentroid)
+		m /= double(triangleCount * 3);
+
+	// sort clusters so that the ones facing away from the mesh center (likely occluders) come first
+	size_t clusterCount = clusters.size();
+	std::vector<float> sortKey(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		unsigned int start = clusters[c];
+		unsigned int end = c + 1 < clusterCount ? clusters[c + 1] : unsigned(triangleCount);
+
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float areaSum = 0.0f;
+		for (unsigned int t = start; t < end; ++t) {
+			const float* p0 = positions + indices[t * 3 + 0] * stride;
+			const float* p1 = positions + indices[t * 3 + 1] * stride;
+			const float* p2 = positions + indices[t * 3 + 2] * stride;
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; ++k) {
+				centroid[k] += (p0[k] + p1[k] + p2[k]) * (area / 3.0f);
+				normal[k] += n[k];
+			}
+			areaSum += area;
+		}
+
+		float invArea = areaSum == 0.0f ? 0.0f : 1.0f / areaSum;
+		float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float invNormal = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+
+		float key = 0.0f;
+		for (int k = 0; k < 3; ++k)
+			key += (centroid[k] * invArea - float(meshCentroid[k])) * (normal[k] * invNormal);
+		sortKey[c] = key;
+	}
+
+	std::vector<unsigned int> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+		order[c] = unsigned(c);
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKey[a] > sortKey[b]; });
+
+	size_t output = 0;
+	for (unsigned int c : order) {
+		unsigned int start = clusters[c];
+		unsigned int end = c + 1 < clusterCount ? clusters[c + 1] : unsigned(triangleCount);
+		memcpy(destination + output, indices + start * 3, (end - start) * 3 * sizeof(unsigned int));
+		output += (end - start) * 3;
+	}
+}
+
+size_t geometry::optimizeVertexFetchRemap(unsigned int* remap, const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+
+	std::fill(remap, remap + vertexCount, ~0u);
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		unsigned int v = indices[i];
+		if (remap[v] == ~0u)
+			remap[v] = next++;
+	}
+	return next;
+}
+
+size_t geometry::generateVertexRemap(unsigned int* remap, const void* vertices, size_t vertexCount, size_t vertexSize,
+	size_t toleranceFloats, float epsilon) {
+
+	VertexHasher hasher = { static_cast<const char*>(vertices), vertexSize, std::min(toleranceFloats, vertexSize / sizeof(float)), epsilon };
+
+	// open addressing table with a power of two size and at most 50% load
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	std::vector<unsigned int> table(tableSize, ~0u);
+
+	unsigned int next = 0;
+	for (size_t v = 0; v < vertexCount; ++v) {
+		size_t slot = hasher.hash(unsigned(v)) & (tableSize - 1);
+		for (size_t probe = 1; ; ++probe) {
+			unsigned int entry = table[slot];
+			if (entry == ~0u) {
+				table[slot] = unsigned(v);
+				remap[v] = next++;
+				break;
+			}
+			if (hasher.equal(entry, unsigned(v))) {
+				remap[v] = remap[entry];
+				break;
+			}
+			slot = (slot + probe) & (tableSize - 1);
+		}
+	}
+	return next;
+}
+
+void geometry::remapIndexBuffer(unsigned int* destination, const unsigned int* indices, size_t indexCount, const unsigned int* remap) {
+
+	for (size_t i = 0; i < indexCount; ++i)
+		destination[i] = remap[indices[i]];
+}
+
+void geometry::remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const unsigned int* remap) {
+
+	char* dst = static_cast<char*>(destination);
+	const char* src = static_cast<const char*>(vertices);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != ~0u)
+			memcpy(dst + remap[v] * vertexSize, src + v * vertexSize, vertexSize);
+	}
+}
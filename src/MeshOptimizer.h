@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+
+// Statistics of a simulated FIFO post-transform vertex cache over an index buffer.
+// acmr: average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3.0 is worst)
+// atvr: average transformed vertex ratio, transformed vertices per vertex (1.0 is ideal)
+struct VertexCacheStatistics {
+	unsigned int verticesTransformed;
+	float acmr;
+	float atvr;
+};
+
+// Index/vertex buffer reordering used by the model import pipeline.
+// All functions work on triangle lists and never change the rendered result, only the order.
+namespace geometry {
+
+	// simulates a FIFO vertex cache of the given size, which is a good model of most hardware
+	VertexCacheStatistics analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+	// reorders triangles to maximize post-transform vertex cache hits (Forsyth's linear-speed algorithm).
+	// destination may not alias indices.
+	void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// reorders clusters of a vertex cache optimized index buffer so that outward facing clusters are drawn first,
+	// which reduces overdraw (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+	// threshold bounds how much the ACMR may get worse, 1.05 allows 5%.
+	// positions points to the first float3 position, positionStride is the vertex size in bytes.
+	void optimizeOverdraw(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+		const float* positions, size_t vertexCount, size_t positionStride, float threshold = 1.05f);
+
+	// builds a remap table that lays vertices out in the order they are first referenced by the index buffer.
+	// unused vertices are mapped to ~0u. returns the number of referenced vertices.
+	size_t optimizeVertexFetchRemap(unsigned int* remap, const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+	// builds a remap table that maps every vertex to the first vertex that is identical to it, using a hash table.
+	// the first toleranceFloats floats of a vertex are compared with the given absolute epsilon, the remaining bytes exactly.
+	// with epsilon 0 everything is compared bit for bit. epsilon matching hashes on a grid of epsilon sized cells,
+	// so two vertices closer than epsilon that fall into neighbouring cells are kept apart, it never welds further than epsilon.
+	// returns the number of unique vertices, remap targets are assigned in order of first occurrence.
+	size_t generateVertexRemap(unsigned int* remap, const void* vertices, size_t vertexCount, size_t vertexSize,
+		size_t toleranceFloats = 0, float epsilon = 0.0f);
+
+	// applies a remap table to an index buffer, destination may alias indices
+	void remapIndexBuffer(unsigned int* destination, const unsigned int* indices, size_t indexCount, const unsigned int* remap);
+
+	// applies a remap table to a vertex buffer of vertexSize byte vertices, destination may not alias vertices
+	void remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const unsigned int* remap);
+}
@@ -0,0 +1,314 @@
+#include "MeshSimplifier.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+	// symmetric 4x4 quadric, accumulated with area weights
+	struct Quadric {
+		float a00, a11, a22, a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float w;
+	};
+
+	void quadricFromTriangle(Quadric& q, const float* p0, const float* p1, const float* p2) {
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float area = length * 0.5f;
+		if (length > 0.0f) {
+			n[0] /= length;
+			n[1] /= length;
+			n[2] /= length;
+		}
+		float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+		q.a00 = n[0] * n[0] * area;
+		q.a11 = n[1] * n[1] * area;
+		q.a22 = n[2] * n[2] * area;
+		q.a10 = n[1] * n[0] * area;
+		q.a20 = n[2] * n[0] * area;
+		q.a21 = n[2] * n[1] * area;
+		q.b0 = n[0] * d * area;
+		q.b1 = n[1] * d * area;
+		q.b2 = n[2] * d * area;
+		q.c = d * d * area;
+		q.w = area;
+	}
+
+	void quadricAdd(Quadric& q, const Quadric& r) {
+		q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+		q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+		q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+		q.c += r.c;
+		q.w += r.w;
+	}
+
+	// mean squared distance of p to the planes accumulated in q
+	float quadricError(const Quadric& q, const float* p) {
+		float x = p[0], y = p[1], z = p[2];
+		float rx = q.a00 * x + q.a10 * y + q.a20 * z + q.b0;
+		float ry = q.a10 * x + q.a11 * y + q.a21 * z + q.b1;
+		float rz = q.a20 * x + q.a21 * y + q.a22 * z + q.b2;
+		float error = rx * x + ry * y + rz * z + q.b0 * x + q.b1 * y + q.b2 * z + q.c;
+		return q.w > 0.0f ? fabsf(error) / q.w : 0.0f;
+	}
+
+	// groups vertices that share a position, wedge[v] is the first vertex of v's group
+	void buildPositionWedges(std::vector<unsigned int>& wedge, const float* positions, size_t vertexCount, size_t stride) {
+		std::vector<unsigned int> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			order[v] = unsigned(v);
+
+		auto less = [&](unsigned int a, unsigned int b) {
+			const float* pa = positions + a * stride;
+			const float* pb = positions + b * stride;
+			if (pa[0] != pb[0]) return pa[0] < pb[0];
+			if (pa[1] != pb[1]) return pa[1] < pb[1];
+			if (pa[2] != pb[2]) return pa[2] < pb[2];
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		wedge.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; ) {
+			size_t j = i + 1;
+			const float* pi = positions + order[i] * stride;
+			while (j < vertexCount && memcmp(pi, positions + order[j] * stride, 3 * sizeof(float)) == 0)
+				j++;
+			for (size_t k = i; k < j; ++k)
+				wedge[order[k]] = order[i];
+			i = j;
+		}
+	}
+
+	void triangleNormal(float* n, const float* p0, const float* p1, const float* p2) {
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+}
+
+float geometry::simplifyScale(const float* positions, size_t vertexCount, size_t positionStride) {
+
+	size_t stride = positionStride / sizeof(float);
+	if (vertexCount == 0)
+		return 0.0f;
+
+	float minimum[3] = { positions[0], positions[1], positions[2] };
+	float maximum[3] = { positions[0], positions[1], positions[2] };
+	for (size_t v = 1; v < vertexCount; ++v) {
+		const float* p = positions + v * stride;
+		for (int k = 0; k < 3; ++k) {
+			minimum[k] = std::min(minimum[k], p[k]);
+			maximum[k] = std::max(maximum[k], p[k]);
+		}
+	}
+	return std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+}
+
+size_t geometry::simplify(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+	const float* positions, size_t vertexCount, size_t positionStride,
+	size_t targetIndexCount, float targetError, float* resultError) {
+
+	const size_t stride = positionStride / sizeof(float);
+	if (destination != indices)
+		memmove(destination, indices, indexCount * sizeof(unsigned int));
+	size_t count = indexCount / 3 * 3;
+	if (resultError)
+		*resultError = 0.0f;
+
+	float scale = simplifyScale(positions, vertexCount, positionStride);
+	if (count <= targetIndexCount || scale <= 0.0f)
+		return count;
+
+	std::vector<unsigned int> wedge;
+	buildPositionWedges(wedge, positions, vertexCount, stride);
+
+	// classify vertices, only interior vertices with a single wedge may move
+	std::vector<unsigned int> wedgeSize(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		wedgeSize[wedge[v]]++;
+
+	std::vector<uint64_t> edges;
+	edges.reserve(count);
+	for (size_t i = 0; i < count; i += 3) {
+		for (int k = 0; k < 3; ++k) {
+			uint64_t a = wedge[destination[i + k]], b = wedge[destination[i + (k + 1) % 3]];
+			edges.push_back((a << 32) | b);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<char> locked(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		locked[v] = wedgeSize[wedge[v]] > 1;
+
+	std::vector<char> lockedWedge(vertexCount, 0);
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		unsigned int a = unsigned(edges[i] >> 32), b = unsigned(edges[i] & 0xffffffffu);
+		uint64_t opposite = (uint64_t(b) << 32) | a;
+		// open border or non-manifold edge
+		if (j - i > 1 || !std::binary_search(edges.begin(), edges.end(), opposite))
+			lockedWedge[a] = lockedWedge[b] = 1;
+		i = j;
+	}
+	for (size_t v = 0; v < vertexCount; ++v)
+		locked[v] |= lockedWedge[wedge[v]];
+
+	// plane quadrics, accumulated per position
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, vertexCount * sizeof(Quadric));
+	for (size_t i = 0; i < count; i += 3) {
+		Quadric q;
+		quadricFromTriangle(q, positions + destination[i] * stride, positions + destination[i + 1] * stride, positions + destination[i + 2] * stride);
+		for (int k = 0; k < 3; ++k)
+			quadricAdd(quadrics[wedge[destination[i + k]]], q);
+	}
+
+	const float errorLimit = (targetError * scale) * (targetError * scale);
+	float maxError = 0.0f;
+
+	struct Collapse {
+		unsigned int from, to;
+		float error;
+	};
+	std::vector<Collapse> candidates;
+	std::vector<unsigned int> offsets(vertexCount + 1), adjacency, fill;
+	std::vector<unsigned int> collapseRemap(vertexCount);
+	std::vector<char> touched(vertexCount);
+	std::vector<unsigned int> neighbourMark(vertexCount, 0);
+	unsigned int stamp = 0;
+
+	while (count > targetIndexCount) {
+
+		// triangle adjacency of the current index buffer
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < count; ++i)
+			offsets[destination[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(count);
+		fill.assign(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < count; ++i)
+			adjacency[fill[destination[i]]++] = unsigned(i / 3);
+
+		// every edge that starts at a movable vertex is a candidate, cheapest first
+		candidates.clear();
+		for (size_t i = 0; i < count; i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				unsigned int a = destination[i + k], b = destination[i + (k + 1) % 3];
+				if (!locked[a]) {
+					float error = quadricError(quadrics[wedge[a]], positions + b * stride);
+					if (error <= errorLimit)
+						candidates.push_back({ a, b, error });
+				}
+				if (!locked[b]) {
+					float error = quadricError(quadrics[wedge[b]], positions + a * stride);
+					if (error <= errorLimit)
+						candidates.push_back({ b, a, error });
+				}
+			}
+		}
+		if (candidates.empty())
+			break;
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		for (size_t v = 0; v < vertexCount; ++v)
+			collapseRemap[v] = unsigned(v);
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// collapses within a pass never share a one-ring, so the adjacency stays valid for all of them
+		size_t collapses = 0;
+		size_t remaining = count / 3;
+		for (const Collapse& collapse : candidates) {
+			if (remaining * 3 <= targetIndexCount)
+				break;
+			unsigned int a = collapse.from, b = collapse.to;
+			if (touched[a] || touched[b])
+				continue;
+
+			// link condition: an interior edge has exactly two common neighbours, more would pinch the surface
+			stamp++;
+			for (unsigned int j = offsets[b]; j < offsets[b + 1]; ++j) {
+				const unsigned int* tri = destination + adjacency[j] * 3;
+				for (int k = 0; k < 3; ++k)
+					neighbourMark[tri[k]] = stamp;
+			}
+			unsigned int common = 0;
+			unsigned int lastCommon = ~0u, firstCommon = ~0u;
+			bool flipped = false;
+			for (unsigned int j = offsets[a]; j < offsets[a + 1] && !flipped; ++j) {
+				const unsigned int* tri = destination + adjacency[j] * 3;
+				bool hasB = tri[0] == b || tri[1] == b || tri[2] == b;
+				for (int k = 0; k < 3; ++k) {
+					unsigned int n = tri[k];
+					if (n != a && n != b && neighbourMark[n] == stamp && n != firstCommon && n != lastCommon) {
+						if (firstCommon == ~0u) firstCommon = n; else lastCommon = n;
+						common++;
+					}
+				}
+				if (hasB)
+					continue;
+
+				// moving a onto b must not flip any of the remaining triangles
+				float before[3], after[3];
+				const float* p[3];
+				for (int k = 0; k < 3; ++k)
+					p[k] = positions + tri[k] * stride;
+				triangleNormal(before, p[0], p[1], p[2]);
+				for (int k = 0; k < 3; ++k)
+					if (tri[k] == a)
+						p[k] = positions + b * stride;
+				triangleNormal(after, p[0], p[1], p[2]);
+				float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				float lengths = sqrtf((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+					(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+				flipped = dot <= 1e-2f * lengths;
+			}
+			if (flipped || common != 2)
+				continue;
+
+			collapseRemap[a] = b;
+			touched[b] = 1;
+			for (unsigned int j = offsets[a]; j < offsets[a + 1]; ++j) {
+				const unsigned int* tri = destination + adjacency[j] * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			quadricAdd(quadrics[wedge[b]], quadrics[wedge[a]]);
+			maxError = std::max(maxError, collapse.error);
+			collapses++;
+			remaining -= 2;
+		}
+		if (collapses == 0)
+			break;
+
+		// apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < count; i += 3) {
+			unsigned int a = collapseRemap[destination[i]];
+			unsigned int b = collapseRemap[destination[i + 1]];
+			unsigned int c = collapseRemap[destination[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			destination[write++] = a;
+			destination[write++] = b;
+			destination[write++] = c;
+		}
+		count = write;
+	}
+
+	if (resultError)
+		*resultError = sqrtf(maxError) / scale;
+	return count;
+}
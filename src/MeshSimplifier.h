@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+
+// Quadric error metric simplification for building levels of detail at import.
+namespace geometry {
+
+	// reduces the triangle count of an indexed triangle list towards targetIndexCount by collapsing edges
+	// (Garland & Heckbert quadrics). only vertices in the interior of the surface are moved: vertices on open
+	// borders (which is also where neighbouring meshes with other materials attach) and on attribute seams,
+	// where several vertices share one position with different normals/uvs, are locked. the result reuses the
+	// original vertex buffer, so all levels of detail of a mesh can share it.
+	// targetError is the largest allowed deviation relative to the mesh extent (0.01 = 1%).
+	// returns the new index count, the achieved relative error is written to resultError if given.
+	// destination needs room for indexCount indices and may alias indices.
+	size_t simplify(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+		const float* positions, size_t vertexCount, size_t positionStride,
+		size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+	// returns the mesh extent that the relative errors of simplify are measured against
+	float simplifyScale(const float* positions, size_t vertexCount, size_t positionStride);
+}
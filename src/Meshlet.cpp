@@ -0,0 +1,182 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "glm/geometric.hpp"
+#include "glm/common.hpp"
+
+namespace {
+
+	// a cluster that runs out of connected triangles only jumps to an unconnected part of the mesh while it is this small
+	const unsigned int kMeshletMinTriangles = 16;
+
+	glm::vec3 position(const float* positions, size_t stride, unsigned int index) {
+		const float* p = positions + index * stride;
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+}
+
+void geometry::buildMeshlets(std::vector<Meshlet>& meshlets, unsigned int* destination, const unsigned int* indices, size_t indexCount,
+	const float* positions, size_t vertexCount, size_t positionStride, unsigned int maxVertices, unsigned int maxTriangles) {
+
+	meshlets.clear();
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangle adjacency per vertex
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		adjacency[fill[indices[i]]++] = unsigned(i / 3);
+
+	std::vector<char> emitted(triangleCount, 0);
+	// vertices of the current meshlet are marked with its stamp
+	std::vector<unsigned int> owner(vertexCount, ~0u);
+	unsigned int stamp = 0;
+	std::vector<unsigned int> meshletVertices;
+	meshletVertices.reserve(maxVertices);
+
+	Meshlet current = {};
+	size_t written = 0, cursor = 0;
+
+	auto newVertices = [&](unsigned int t) {
+		unsigned int count = 0;
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = indices[t * 3 + k];
+			// a degenerate triangle may list the same new vertex twice
+			bool repeated = (k > 0 && indices[t * 3] == v) || (k > 1 && indices[t * 3 + 1] == v);
+			if (owner[v] != stamp && !repeated)
+				count++;
+		}
+		return count;
+	};
+
+	auto finish = [&]() {
+		if (current.triangleCount > 0) {
+			current.vertexCount = unsigned(meshletVertices.size());
+			computeMeshletBounds(current, destination + current.indexOffset, positions, positionStride);
+			meshlets.push_back(current);
+		}
+		meshletVertices.clear();
+		stamp++;
+		current = Meshlet();
+		current.indexOffset = unsigned(written);
+	};
+
+	while (written < triangleCount * 3) {
+
+		// grow over the triangle that adds the fewest vertices to the cluster
+		unsigned int best = ~0u, bestNew = 4;
+		for (size_t i = 0; i < meshletVertices.size() && bestNew > 0; ++i) {
+			unsigned int v = meshletVertices[i];
+			for (unsigned int j = offsets[v]; j < offsets[v + 1]; ++j) {
+				unsigned int t = adjacency[j];
+				if (emitted[t])
+					continue;
+				unsigned int count = newVertices(t);
+				if (count < bestNew) {
+					best = t;
+					bestNew = count;
+					if (count == 0)
+						break;
+				}
+			}
+		}
+
+		if (best == ~0u) {
+			// nothing connected is left, either close the cluster or continue in input order
+			if (current.triangleCount >= kMeshletMinTriangles) {
+				finish();
+				continue;
+			}
+			while (emitted[cursor])
+				cursor++;
+			best = unsigned(cursor);
+			bestNew = newVertices(best);
+		}
+
+		if (meshletVertices.size() + bestNew > maxVertices || current.triangleCount + 1 > maxTriangles) {
+			finish();
+			continue;
+		}
+
+		for (int k = 0; k < 3; ++k) {
+			unsigned int v = indices[best * 3 + k];
+			if (owner[v] != stamp) {
+				owner[v] = stamp;
+				meshletVertices.push_back(v);
+			}
+			destination[written++] = v;
+		}
+		emitted[best] = 1;
+		current.triangleCount++;
+	}
+	finish();
+}
+
+void geometry::computeMeshletBounds(Meshlet& meshlet, const unsigned int* indices, const float* positions, size_t positionStride) {
+
+	size_t stride = positionStride / sizeof(float);
+	size_t indexCount = meshlet.triangleCount * 3;
+
+	// sphere around the bounding box of the cluster
+	glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+	for (size_t i = 0; i < indexCount; ++i) {
+		glm::vec3 p = position(positions, stride, indices[i]);
+		minimum = glm::min(minimum, p);
+		maximum = glm::max(maximum, p);
+	}
+	meshlet.center = (minimum + maximum) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (size_t i = 0; i < indexCount; ++i)
+		meshlet.radius = std::max(meshlet.radius, glm::length(position(positions, stride, indices[i]) - meshlet.center));
+
+	// normal cone around the average triangle normal
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 axis(0.0f);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		glm::vec3 p0 = position(positions, stride, indices[i]);
+		glm::vec3 n = glm::cross(position(positions, stride, indices[i + 1]) - p0, position(positions, stride, indices[i + 2]) - p0);
+		float length = glm::length(n);
+		normals.push_back(length > 0.0f ? n / length : glm::vec3(0.0f));
+		axis += normals.back();
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = geometry::kMeshletNoCone;
+	float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return;
+	axis /= axisLength;
+	meshlet.coneAxis = axis;
+
+	float minimumDot = 1.0f;
+	for (const glm::vec3& n : normals)
+		if (n != glm::vec3(0.0f))
+			minimumDot = std::min(minimumDot, glm::dot(axis, n));
+
+	// a cone wider than ~85 degrees is visible from almost everywhere, leave it uncullable
+	if (minimumDot <= 0.1f)
+		return;
+
+	// the apex is the point on the axis behind the planes of all triangles
+	float maxT = 0.0f;
+	for (size_t i = 0; i < indexCount; i += 3) {
+		const glm::vec3& n = normals[i / 3];
+		if (n == glm::vec3(0.0f))
+			continue;
+		float t = glm::dot(meshlet.center - position(positions, stride, indices[i]), n) / glm::dot(axis, n);
+		maxT = std::max(maxT, t);
+	}
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	// the back facing region is the normal cone widened by 90 degrees on each side and inverted: sin of the cone angle
+	meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+}
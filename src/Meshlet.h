@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/ext/vector_float3.hpp"
+
+// A small cluster of a mesh, a contiguous range of its index buffer with culling data.
+struct Meshlet {
+	unsigned int indexOffset;
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+	// bounding sphere in model space
+	glm::vec3 center;
+	float radius;
+	// normal cone, the whole cluster faces away from the camera when
+	// dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff.
+	// clusters with too wide a cone get kMeshletNoCone, which no dot product reaches.
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+namespace geometry {
+
+	const unsigned int kMeshletMaxVertices = 64;
+	const unsigned int kMeshletMaxTriangles = 124;
+	const float kMeshletNoCone = 2.0f;
+
+	// splits a triangle list into clusters of at most maxVertices unique vertices and maxTriangles triangles.
+	// clusters grow greedily over shared vertices, starting from the input order, and the triangles are written
+	// to destination grouped by cluster so every meshlet is one range of it. destination may not alias indices.
+	void buildMeshlets(std::vector<Meshlet>& meshlets, unsigned int* destination, const unsigned int* indices, size_t indexCount,
+		const float* positions, size_t vertexCount, size_t positionStride,
+		unsigned int maxVertices = kMeshletMaxVertices, unsigned int maxTriangles = kMeshletMaxTriangles);
+
+	// fills in the bounding sphere and normal cone of a meshlet from the triangles of its range
+	void computeMeshletBounds(Meshlet& meshlet, const unsigned int* indices, const float* positions, size_t positionStride);
+}
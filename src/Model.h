@@ -7,7 +7,24 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cctype>
 #include "Mesh.h"
+#include "Camera.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ScratchArena.h"
+#include "TransformHierarchy.h"
+#include "Animation.h"
+#include "Skinning.h"
+#include "InstanceBuffer.h"
+#include "Culling.h"
+#include "OcclusionBuffer.h"
+#include "ObjLoader.h"
+#include "AssetFile.h"
+#include "MappedIOSystem.h"
 #include "stb_image.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -17,6 +34,38 @@ using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
+// optional processing applied to every mesh after it has been read from ASSIMP
+struct ModelImportOptions {
+    // collapse vertices with identical attributes, ASSIMP is not asked to join identical vertices
+    bool weldVertices = false;
+    // 0 welds only bit-identical vertices, otherwise position/normal/uv/tangent/bitangent may differ by up to this much
+    float weldEpsilon = 0.0f;
+    // reorder triangles for the post-transform vertex cache and overdraw, and vertices for fetch locality
+    bool optimizeMeshes = false;
+    // how much worse than the cache optimized order the overdraw pass may make the ACMR (1.05 = 5%)
+    float overdrawThreshold = 1.05f;
+    // split the full detail level of every mesh into small clusters with culling data, see Model::DrawClusters
+    bool buildMeshlets = false;
+    // append simplified levels of detail to every mesh, see Model::SelectLod
+    bool generateLods = false;
+    // number of levels including the full detail one, every level aims for half the triangles of the previous (3-5 is sensible)
+    unsigned int lodCount = 4;
+    // largest deviation a single simplification step may introduce, relative to the mesh size
+    float lodTargetError = 0.02f;
+    // print per-mesh vertex counts and ACMR/ATVR before and after the welding/optimization
+    bool printStatistics = false;
+    // keep Mesh::vertices/indices after the upload, for picking or physics on the CPU. drawing doesn't need them
+    bool keepCpuGeometry = false;
+    // read .obj files with the multithreaded geometry::loadObj instead of ASSIMP, which stays the fallback
+    bool nativeObjLoader = true;
+    // pack all textures of the same size and format into the layers of one GL_TEXTURE_2D_ARRAY, so meshes that only
+    // differ by texture share their binds. needs a shader with sampler2DArray samplers (1.model_loading_array.fs)
+    bool textureArrays = false;
+    // keep the positions and triangles of this level of detail for RenderOccluders, -1 keeps none. a coarse level
+    // rasterizes faster but may hide objects near the silhouette, the full level (0) never does
+    int occluderLod = -1;
+};
+
 class Model
 {
 public:
@@ -25,26 +74,274 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    ModelImportOptions importOptions;
+    // vertex and index buffers all meshes are suballocated from, may be shared with other models
+    shared_ptr<GeometryArena> geometry;
+    // the node tree of the file with the aiNode transformations, node 0 is the root. OBJ files only have the root
+    TransformHierarchy nodes;
+    // bones of the skinned meshes by name, see Animation::Load
+    BoneInfoMap boneInfoMap;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. without an arena the model creates its own
+    Model(string const& path, bool gamma = false, const ModelImportOptions& options = ModelImportOptions(),
+        shared_ptr<GeometryArena> arena = nullptr) : gammaCorrection(gamma), importOptions(options), geometry(arena)
     {
+        if (!geometry)
+            geometry = make_shared<GeometryArena>();
         loadModel(path);
+        if (nodes.GetNodeCount() == 0)
+            nodes.AddNode(TransformHierarchy::kNoParent);
+        nodes.Update();
+
+        nodeTransforms = false;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            nodeTransforms = nodeTransforms || meshMatrix(glm::mat4(1.0f), meshes[i]) != glm::mat4(1.0f);
+        computeMeshBounds();
+    }
+
+    // tests the bounding box of every mesh against frustum, which has to be in model space (from viewProjection * model).
+    // the result is kept for the following draws, see IsMeshVisible. returns how many meshes can be visible
+    size_t CullMeshes(const Frustum& frustum)
+    {
+        meshVisible.resize(meshes.size());
+        size_t visibleCount = geometry::cullBoxes(frustum, meshBounds, meshVisible.data());
+        // the boxes are in the bind pose, an animation can move skinned meshes anywhere
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (meshes[i].skinned && !meshVisible[i])
+            {
+                meshVisible[i] = 1;
+                visibleCount++;
+            }
+        }
+        return visibleCount;
+    }
+
+    bool IsMeshVisible(unsigned int mesh) const
+    {
+        return mesh >= meshVisible.size() || meshVisible[mesh] != 0;
+    }
+
+    // rasterizes the occluder triangles of the unskinned meshes placed by model, needs ModelImportOptions::occluderLod
+    void RenderOccluders(OcclusionBuffer& buffer, const glm::mat4& model) const
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh& mesh = meshes[i];
+            if (mesh.skinned || mesh.occluderIndices.empty())
+                continue;
+            buffer.AddOccluder(mesh.occluderPositions.data(), mesh.occluderPositions.size(), mesh.occluderIndices.data(),
+                mesh.occluderIndices.size(), meshMatrix(model, mesh));
+        }
+    }
+
+    // culls the meshes against viewProjection and queues the visible unskinned ones into batch, to be drawn with the
+    // shared arena VAO bound (1.model_loading_indirect.vs). meshes sharing texture arrays share one material
+    void AppendDraws(MultiDrawBatch& batch, const glm::mat4& model, const glm::mat4& viewProjection)
+    {
+        if (CullMeshes(Frustum::FromMatrix(viewProjection * model)) == 0)
+            return;
+        const Mesh* material = nullptr;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!material || !meshes[i].SharesTextureBindings(*material))
+                material = &meshes[i];
+            if (meshes[i].skinned || !meshVisible[i])
+                continue;
+            meshes[i].AppendDraw(batch, *material, meshMatrix(model, meshes[i]));
+        }
+    }
+
+    // model space box around all meshes, skinned ones in their bind pose
+    void GetBounds(glm::vec3& minimum, glm::vec3& maximum) const
+    {
+        minimum = glm::vec3(0.0f);
+        maximum = glm::vec3(0.0f);
+        for (size_t i = 0; i < meshBounds.Size(); i++)
+        {
+            glm::vec3 center(meshBounds.centerX[i], meshBounds.centerY[i], meshBounds.centerZ[i]);
+            glm::vec3 extent(meshBounds.extentX[i], meshBounds.extentY[i], meshBounds.extentZ[i]);
+            minimum = i == 0 ? center - extent : glm::min(minimum, center - extent);
+            maximum = i == 0 ? center + extent : glm::max(maximum, center + extent);
+        }
+    }
+
+    // draws the model, and thus all its meshes, with a single VAO bind. model is the matrix the shader's "model"
+    // uniform holds, meshes on transformed nodes set it to model * node matrix themselves
+    void Draw(Shader& shader, const glm::mat4& model = glm::mat4(1.0f))
+    {
+        geometry->Bind();
+        const Mesh* bound = nullptr;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (nodeTransforms)
+                shader.setMat4("model", meshMatrix(model, meshes[i]));
+            // meshes sharing texture arrays are sorted next to each other, only the layers change between them
+            bool rebind = !bound || !meshes[i].SharesTextureBindings(*bound);
+            if (meshes[i].Submit(shader, rebind) && rebind)
+                bound = &meshes[i];
+        }
+        glBindVertexArray(0);
+    }
+
+    // draws count instances of the model with one instanced draw per mesh, whatever count is. the transforms are
+    // streamed into a per-instance attribute, the shader reads them at InstanceBuffer::kFirstLocation
+    // (1.model_loading_instanced.vs) and its "model" uniform holds the node matrix of the mesh
+    void DrawInstanced(Shader& shader, const glm::mat4* transforms, size_t count)
+    {
+        if (count == 0)
+            return;
+        if (!instances)
+            instances.reset(new InstanceBuffer(count));
+        instances->Upload(transforms, count);
+
+        geometry->Bind();
+        instances->Attach(geometry->VAO);
+        if (!nodeTransforms)
+            shader.setMat4("model", glm::mat4(1.0f));
+        const Mesh* bound = nullptr;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (nodeTransforms)
+                shader.setMat4("model", meshMatrix(glm::mat4(1.0f), meshes[i]));
+            bool rebind = !bound || !meshes[i].SharesTextureBindings(*bound);
+            if (meshes[i].SubmitInstanced(shader, static_cast<GLsizei>(count), rebind) && rebind)
+                bound = &meshes[i];
+        }
+        instances->Detach(geometry->VAO);
+        glBindVertexArray(0);
+    }
+
+    void DrawInstanced(Shader& shader, const vector<glm::mat4>& transforms)
+    {
+        DrawInstanced(shader, transforms.data(), transforms.size());
+    }
+
+    // draws the model with per-cluster frustum and back-face culling for meshes that have meshlets
+    void DrawClusters(Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition)
+    {
+        // without node transformations all meshes share the model space, see Mesh::DrawClusters
+        Frustum frustum = Frustum::FromMatrix(viewProjection * model);
+        glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+        bool facingTest = geometry::preservesAngles(model);
+        // whole meshes first, the mesh boxes are in model space either way
+        if (CullMeshes(frustum) == 0)
+            return;
+
+        geometry->Bind();
+        const Mesh* bound = nullptr;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!meshVisible[i])
+                continue;
+            if (nodeTransforms)
+            {
+                glm::mat4 meshModel = meshMatrix(model, meshes[i]);
+                shader.setMat4("model", meshModel);
+                frustum = Frustum::FromMatrix(viewProjection * meshModel);
+                eye = glm::vec3(glm::inverse(meshModel) * glm::vec4(cameraPosition, 1.0f));
+                facingTest = geometry::preservesAngles(meshModel);
+            }
+            bool rebind = !bound || !meshes[i].SharesTextureBindings(*bound);
+            if (meshes[i].SubmitClusters(shader, frustum, eye, facingTest, rebind) && rebind)
+                bound = &meshes[i];
+        }
+        glBindVertexArray(0);
+    }
+
+    // picks the level of detail of every mesh from the size of its bounding sphere on screen. a level is used while its
+    // simplification error, scaled by the projected sphere, stays below maxPixelError pixels. hysteresis moves the switch
+    // point by that fraction in both directions, so meshes right at a switch distance don't pop between two levels.
+    void SelectLod(const Camera& camera, const glm::mat4& model, float viewportHeight, float maxPixelError = 1.0f, float hysteresis = 0.15f)
+    {
+        float pixelsPerUnit = viewportHeight / (2.0f * tan(glm::radians(camera.Zoom) * 0.5f));
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh& mesh = meshes[i];
+            if (mesh.lods.size() < 2 || mesh.boundsRadius <= 0.0f)
+                continue;
+
+            // the mesh is scaled by the largest axis scale of its model matrix
+            glm::mat4 meshModel = meshMatrix(model, mesh);
+            float scale = sqrt(glm::max(glm::dot(meshModel[0], meshModel[0]), glm::max(glm::dot(meshModel[1], meshModel[1]), glm::dot(meshModel[2], meshModel[2]))));
+            glm::vec3 center = glm::vec3(meshModel * glm::vec4(mesh.boundsCenter, 1.0f));
+            float radius = mesh.boundsRadius * scale;
+            float distance = glm::max(glm::length(center - camera.Position) - radius, 1e-3f);
+            float projectedDiameter = 2.0f * radius * pixelsPerUnit / distance;
+            // lod errors are in model space, relative to the sphere they become a fraction of the projected diameter
+            float pixelsPerError = projectedDiameter / (2.0f * mesh.boundsRadius);
+
+            unsigned int level = mesh.currentLod;
+            while (level > 0 && mesh.lods[level].error * pixelsPerError > maxPixelError * (1.0f + hysteresis))
+                level--;
+            while (level + 1 < mesh.lods.size() && mesh.lods[level + 1].error * pixelsPerError < maxPixelError * (1.0f - hysteresis))
+                level++;
+            mesh.currentLod = level;
+        }
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader& shader)
+    // CPU fallback for the skinning vertex shader: skins the kept CPU vertices of the skinned meshes with palette
+    // (see Animator) and overwrites their vertices in the geometry arena. all draws of the model show that pose.
+    // needs ModelImportOptions::keepCpuGeometry
+    void UploadSkinnedVertices(const vector<glm::mat4>& palette)
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            Mesh& mesh = meshes[i];
+            if (!mesh.skinned)
+                continue;
+            if (mesh.vertices.empty())
+            {
+                cout << "ERROR::MODEL:: CPU skinning needs the vertices, import with keepCpuGeometry" << endl;
+                return;
+            }
+            skinnedVertices.resize(mesh.vertices.size());
+            geometry::skinVertices(skinnedVertices.data(), mesh.vertices.data(), mesh.vertices.size(), palette.data(), palette.size());
+            glNamedBufferSubData(geometry->VBO, mesh.baseVertex * sizeof(Vertex), skinnedVertices.size() * sizeof(Vertex), skinnedVertices.data());
+        }
     }
 
 private:
+    // whether any mesh sits on a node with a non-identity world matrix, only then the draws set per-mesh model matrices
+    bool nodeTransforms;
+    // output of UploadSkinnedVertices, reused between frames
+    vector<Vertex> skinnedVertices;
+    // transforms of DrawInstanced, created by the first instanced draw
+    unique_ptr<InstanceBuffer> instances;
+    // model space box of every mesh with its node transformation at load time, and the result of the last CullMeshes
+    BoxBounds meshBounds;
+    vector<unsigned char> meshVisible;
+
+    void computeMeshBounds()
+    {
+        meshBounds.Clear();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshBounds.AddTransformed(meshes[i].boundsMin, meshes[i].boundsMax, meshMatrix(glm::mat4(1.0f), meshes[i]));
+        meshVisible.assign(meshes.size(), 1);
+    }
+
+    glm::mat4 meshMatrix(const glm::mat4& model, const Mesh& mesh) const
+    {
+        return mesh.skinned ? model : model * nodes.GetWorld(mesh.node);
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
-        // read file via ASSIMP
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (importOptions.nativeObjLoader && isObjFile(path) && loadObjModel(path))
+        {
+            if (importOptions.textureArrays)
+                packTextureArrays();
+            if (importOptions.printStatistics)
+                cout << "MODEL::IMPORT:: " << path << " read in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+            return;
+        }
+
+        // read file via ASSIMP, through memory mapped files (the importer owns and deletes the IO system)
         Assimp::Importer importer;
+        importer.SetIOHandler(new MappedIOSystem());
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_FlipUVs);
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -55,40 +352,112 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
+        // temporary buffers of all meshes come from one arena that lives as long as the import
+        ScratchArena scratch;
+        meshes.reserve(meshes.size() + scene->mNumMeshes);
+
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, scratch, TransformHierarchy::kNoParent);
+        if (importOptions.textureArrays)
+            packTextureArrays();
+
+        if (importOptions.printStatistics)
+        {
+            cout << "MODEL::IMPORT:: " << meshes.size() << " meshes, peak scratch memory " << scratch.GetPeakBytes() / 1024 << " KB" << endl;
+            cout << "MODEL::IMPORT:: " << path << " read in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+        }
+    }
+
+    static bool isObjFile(const string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == string::npos)
+            return false;
+        string extension = path.substr(dot + 1);
+        for (char& c : extension)
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return extension == "obj";
+    }
+
+    // the OBJ fast path, returns false to fall back to ASSIMP when the file can't be parsed
+    bool loadObjModel(string const& path)
+    {
+        ObjModel obj;
+        if (!geometry::loadObj(obj, path))
+            return false;
+        directory = path.substr(0, path.find_last_of('/'));
+
+        ScratchArena scratch;
+        meshes.reserve(meshes.size() + obj.meshes.size());
+        for (unsigned int i = 0; i < obj.meshes.size(); i++)
+        {
+            ObjMesh& mesh = obj.meshes[i];
+            // same texture slots as the ASSIMP path in processMesh
+            vector<Texture> textures;
+            const ObjMaterial* material = obj.FindMaterial(mesh.material);
+            if (material)
+            {
+                if (!material->diffuseMap.empty())
+                    textures.push_back(loadTexture(material->diffuseMap.c_str(), "texture_diffuse"));
+                if (!material->specularMap.empty())
+                    textures.push_back(loadTexture(material->specularMap.c_str(), "texture_specular"));
+                if (!material->normalMap.empty())
+                    textures.push_back(loadTexture(material->normalMap.c_str(), "texture_normal"));
+                if (!material->heightMap.empty())
+                    textures.push_back(loadTexture(material->heightMap.c_str(), "texture_height"));
+            }
+            addMesh(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures), scratch);
+        }
+
+        if (importOptions.printStatistics)
+            cout << "MODEL::IMPORT:: " << meshes.size() << " meshes, peak scratch memory " << scratch.GetPeakBytes() / 1024 << " KB" << endl;
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    void processNode(aiNode* node, const aiScene* scene, ScratchArena& scratch, int parent)
     {
+        // the node is added before its children, which keeps the hierarchy in parent before child order.
+        // ASSIMP matrices are row major, glm ones column major
+        const aiMatrix4x4& m = node->mTransformation;
+        int index = nodes.AddNode(parent, glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+            m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4));
+
         // process each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene, scratch);
+            meshes.back().node = index;
+            meshes.back().skinned = mesh->HasBones();
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, scratch, index);
         }
 
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // reads an ASSIMP mesh and appends it to meshes
+    void processMesh(aiMesh* mesh, const aiScene* scene, ScratchArena& scratch)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        // the levels of detail are appended behind the full index buffer. the reserve is a guess: a level usually
+        // halves the previous one so twice the size covers the chain, buildLods accepts levels of up to 9/10 of the
+        // previous one though, and a mesh that simplifies that poorly (up to ~3.1x more) reallocates
+        indices.reserve(mesh->mNumFaces * 3 * (importOptions.generateLods ? 2 : 1));
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {}; // zero everything so that unused attributes don't keep identical vertices apart when welding
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -128,6 +497,7 @@ private:
 
             vertices.push_back(vertex);
         }
+        extractBoneWeights(vertices, mesh);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -158,8 +528,316 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        addMesh(std::move(vertices), std::move(indices), std::move(textures), scratch);
+    }
+
+    // fills in the bone ids and weights of the vertices and adds the mesh's bones to boneInfoMap. vertices keep
+    // the MAX_BONE_INFLUENCE largest weights, renormalized when some had to be dropped
+    void extractBoneWeights(vector<Vertex>& vertices, const aiMesh* mesh)
+    {
+        if (!mesh->HasBones())
+            return;
+
+        bool dropped = false;
+        for (unsigned int b = 0; b < mesh->mNumBones; b++)
+        {
+            const aiBone* bone = mesh->mBones[b];
+            string name = bone->mName.C_Str();
+            BoneInfoMap::iterator info = boneInfoMap.find(name);
+            if (info == boneInfoMap.end())
+            {
+                const aiMatrix4x4& m = bone->mOffsetMatrix;
+                BoneInfo newInfo;
+                newInfo.id = static_cast<int>(boneInfoMap.size());
+                newInfo.offset = glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+                    m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+                info = boneInfoMap.insert(make_pair(name, newInfo)).first;
+            }
+
+            for (unsigned int w = 0; w < bone->mNumWeights; w++)
+            {
+                const aiVertexWeight& weight = bone->mWeights[w];
+                if (weight.mVertexId >= vertices.size() || weight.mWeight <= 0.0f)
+                    continue;
+                Vertex& vertex = vertices[weight.mVertexId];
+                // an empty slot, or else the smallest weight if the new one is larger
+                int slot = 0;
+                for (int i = 1; i < MAX_BONE_INFLUENCE; i++)
+                {
+                    if (vertex.m_Weights[i] < vertex.m_Weights[slot])
+                        slot = i;
+                }
+                if (vertex.m_Weights[slot] > 0.0f)
+                {
+                    dropped = true;
+                    if (vertex.m_Weights[slot] >= weight.mWeight)
+                        continue;
+                }
+                vertex.m_BoneIDs[slot] = info->second.id;
+                vertex.m_Weights[slot] = weight.mWeight;
+            }
+        }
+
+        if (!dropped)
+            return;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            float sum = 0.0f;
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                sum += vertices[i].m_Weights[j];
+            if (sum > 0.0f)
+            {
+                for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                    vertices[i].m_Weights[j] /= sum;
+            }
+        }
+    }
+
+    // runs the optional processing on the extracted mesh data and creates the mesh in place.
+    // the vertex and index vectors are moved all the way into the Mesh
+    void addMesh(vector<Vertex>&& vertices, vector<unsigned int>&& indices, vector<Texture>&& textures, ScratchArena& scratch)
+    {
+        scratch.Reset();
+        // room for the levels of detail behind the full index buffer, the same guess as in processMesh
+        if (importOptions.generateLods)
+            indices.reserve(indices.size() * 2);
+
+        // optionally weld, simplify and reorder the mesh for the GPU before it gets uploaded
+        vector<MeshLod> lods;
+        vector<Meshlet> meshlets;
+        if (importOptions.weldVertices && !indices.empty())
+            weldVertices(vertices, indices, scratch);
+        if (importOptions.optimizeMeshes && !indices.empty())
+            optimizeMesh(vertices, indices, scratch);
+        if (importOptions.buildMeshlets && !indices.empty())
+            buildMeshlets(vertices, indices, meshlets, scratch);
+        if (importOptions.generateLods && !indices.empty())
+            buildLods(vertices, indices, lods, scratch);
+        if (importOptions.optimizeMeshes && !indices.empty())
+            optimizeVertexFetch(vertices, indices, scratch);
+
+        meshes.emplace_back(std::move(vertices), std::move(indices), std::move(textures), std::move(lods), std::move(meshlets), geometry.get());
+        if (importOptions.occluderLod >= 0 && !meshes.back().indices.empty())
+            meshes.back().KeepOccluder(importOptions.occluderLod);
+        if (!importOptions.keepCpuGeometry)
+            meshes.back().ReleaseCpuData();
+    }
+
+    // collapses duplicate vertices. ASSIMP emits one vertex per face corner for most formats,
+    // so this is what lets neighbouring triangles share vertices in the post-transform cache.
+    void weldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices, ScratchArena& scratch)
+    {
+        // everything before the bone data is float and may be compared with a tolerance, bone ids/weights must match exactly
+        const size_t toleranceFloats = offsetof(Vertex, m_BoneIDs) / sizeof(float);
+
+        unsigned int* remap = scratch.Allocate<unsigned int>(vertices.size());
+        size_t uniqueVertices = geometry::generateVertexRemap(remap, vertices.data(), vertices.size(), sizeof(Vertex),
+            toleranceFloats, importOptions.weldEpsilon);
+        if (importOptions.printStatistics)
+            cout << "MODEL::WELD:: " << vertices.size() << " -> " << uniqueVertices << " vertices" << endl;
+        if (uniqueVertices == vertices.size())
+            return;
+
+        geometry::remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap);
+        remapVertices(vertices, remap, uniqueVertices, scratch);
+    }
+
+    // moves every vertex to remap[vertex] and shrinks the vector to vertexCount, through a scratch copy instead of a second vector
+    void remapVertices(vector<Vertex>& vertices, const unsigned int* remap, size_t vertexCount, ScratchArena& scratch)
+    {
+        Vertex* source = scratch.Allocate<Vertex>(vertices.size());
+        std::copy(vertices.begin(), vertices.end(), source);
+        size_t sourceCount = vertices.size();
+        vertices.resize(vertexCount);
+        geometry::remapVertexBuffer(vertices.data(), source, sourceCount, sizeof(Vertex), remap);
+    }
+
+    // reorders the triangles for the post-transform vertex cache and then for overdraw.
+    // the rendered result stays the same, only the order of the triangles changes.
+    void optimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices, ScratchArena& scratch)
+    {
+        VertexCacheStatistics before = geometry::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+        // 1. vertex cache, 2. overdraw (keeps the ACMR within overdrawThreshold of the first pass)
+        unsigned int* cacheOrdered = scratch.Allocate<unsigned int>(indices.size());
+        geometry::optimizeVertexCache(cacheOrdered, indices.data(), indices.size(), vertices.size());
+        geometry::optimizeOverdraw(indices.data(), cacheOrdered, indices.size(), &vertices[0].Position.x, vertices.size(), sizeof(Vertex), importOptions.overdrawThreshold);
+
+        if (importOptions.printStatistics)
+        {
+            VertexCacheStatistics after = geometry::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+            cout << "MODEL::OPTIMIZE:: " << indices.size() / 3 << " triangles, ACMR " << before.acmr << " -> " << after.acmr
+                << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+        }
+    }
+
+    // lays out the vertices in the order the index buffer first uses them, this also drops vertices that no triangle references
+    void optimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices, ScratchArena& scratch)
+    {
+        unsigned int* remap = scratch.Allocate<unsigned int>(vertices.size());
+        size_t usedVertices = geometry::optimizeVertexFetchRemap(remap, indices.data(), indices.size(), vertices.size());
+        geometry::remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap);
+        remapVertices(vertices, remap, usedVertices, scratch);
+    }
+
+    // regroups the triangles into clusters of up to 64 vertices and 124 triangles, each cluster gets a bounding sphere and a normal cone
+    void buildMeshlets(vector<Vertex>& vertices, vector<unsigned int>& indices, vector<Meshlet>& meshlets, ScratchArena& scratch)
+    {
+        unsigned int* source = scratch.Allocate<unsigned int>(indices.size());
+        std::copy(indices.begin(), indices.end(), source);
+        geometry::buildMeshlets(meshlets, indices.data(), source, indices.size(), &vertices[0].Position.x, vertices.size(), sizeof(Vertex));
+
+        if (importOptions.printStatistics)
+            cout << "MODEL::MESHLETS:: " << indices.size() / 3 << " triangles in " << meshlets.size() << " clusters" << endl;
+    }
+
+    // appends simplified copies of the index buffer behind the full detail one, all levels share the vertex buffer.
+    // every level is simplified from the previous one, so its error is the sum of the errors of all steps so far.
+    void buildLods(vector<Vertex>& vertices, vector<unsigned int>& indices, vector<MeshLod>& lods, ScratchArena& scratch)
+    {
+        const float* positions = &vertices[0].Position.x;
+        float scale = geometry::simplifyScale(positions, vertices.size(), sizeof(Vertex));
+        unsigned int levels = glm::clamp(importOptions.lodCount, 1u, 5u);
+
+        lods.push_back({ 0, static_cast<unsigned int>(indices.size()), 0.0f });
+        size_t lodCount = indices.size();
+        unsigned int* lod = scratch.Allocate<unsigned int>(lodCount);
+        std::copy(indices.begin(), indices.end(), lod);
+        unsigned int* cacheOrdered = importOptions.optimizeMeshes ? scratch.Allocate<unsigned int>(lodCount) : nullptr;
+        for (unsigned int level = 1; level < levels; level++)
+        {
+            size_t previousCount = lodCount;
+            float previousError = lods.back().error;
+
+            float error = 0.0f;
+            size_t count = geometry::simplify(lod, lod, previousCount, positions, vertices.size(), sizeof(Vertex),
+                previousCount / 6 * 3, importOptions.lodTargetError, &error);
+            // stop once the error budget (or the locked borders and seams) doesn't allow meaningful progress anymore
+            if (count == 0 || count > previousCount * 9 / 10)
+                break;
+            lodCount = count;
+
+            MeshLod next = { static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(count), previousError + error * scale };
+            if (importOptions.optimizeMeshes)
+            {
+                geometry::optimizeVertexCache(cacheOrdered, lod, count, vertices.size());
+                indices.insert(indices.end(), cacheOrdered, cacheOrdered + count);
+            }
+            else
+                indices.insert(indices.end(), lod, lod + count);
+            lods.push_back(next);
+
+            if (importOptions.printStatistics)
+                cout << "MODEL::LOD:: level " << level << ": " << count / 3 << " triangles, error " << next.error << endl;
+        }
+    }
+
+    // moves every loaded texture into a layer of a GL_TEXTURE_2D_ARRAY shared by all textures of its size and format
+    // (GPU side copies of all mip levels), points the meshes at their layers and sorts the meshes by the arrays they bind.
+    // the array shaders sample through sampler2DArray only, so every texture ends up in an array: one of a kind gets an
+    // array of one layer and textures that failed to load share a black 1x1 layer, what an incomplete texture sampled
+    void packTextureArrays()
+    {
+        // textures of equal size and internal format, by index into textures_loaded
+        map<vector<GLint>, vector<unsigned int>> groups;
+        vector<unsigned int> failed;
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            GLint width = 0, height = 0, format = 0;
+            glGetTextureLevelParameteriv(textures_loaded[i].id, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTextureLevelParameteriv(textures_loaded[i].id, 0, GL_TEXTURE_HEIGHT, &height);
+            glGetTextureLevelParameteriv(textures_loaded[i].id, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            if (width > 0 && height > 0)
+                groups[{ width, height, format }].push_back(i);
+            else
+                failed.push_back(i);
+        }
+
+        // old texture name -> its texture in the array
+        map<unsigned int, Texture> packed;
+        for (map<vector<GLint>, vector<unsigned int>>::iterator group = groups.begin(); group != groups.end(); ++group)
+        {
+            GLint width = group->first[0], height = group->first[1], format = group->first[2];
+            GLsizei levels = 1 + static_cast<GLsizei>(floor(log2(static_cast<float>(glm::max(width, height)))));
+            const vector<unsigned int>& members = group->second;
+
+            unsigned int array;
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+            glTextureStorage3D(array, levels, format, width, height, static_cast<GLsizei>(members.size()));
+            // a texture without the full mip chain only gives its base level, the array builds the rest itself
+            bool generateMipmaps = false;
+            for (unsigned int layer = 0; layer < members.size(); layer++)
+            {
+                Texture& texture = textures_loaded[members[layer]];
+                for (GLint level = 0; level < levels; level++)
+                {
+                    GLint levelWidth = 0;
+                    glGetTextureLevelParameteriv(texture.id, level, GL_TEXTURE_WIDTH, &levelWidth);
+                    if (levelWidth == 0)
+                    {
+                        generateMipmaps = true;
+                        break;
+                    }
+                    glCopyImageSubData(texture.id, GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+                        glm::max(width >> level, 1), glm::max(height >> level, 1), 1);
+                }
+                glDeleteTextures(1, &texture.id);
+
+                packed[texture.id] = texture;
+                Texture& layered = packed[texture.id];
+                layered.id = array;
+                layered.target = GL_TEXTURE_2D_ARRAY;
+                layered.layer = layer;
+                texture = layered;
+            }
+            glTextureParameteri(array, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTextureParameteri(array, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTextureParameteri(array, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTextureParameteri(array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (generateMipmaps)
+                glGenerateTextureMipmap(array);
+        }
+
+        if (!failed.empty())
+        {
+            unsigned int placeholder;
+            const unsigned char black[4] = { 0, 0, 0, 255 };
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &placeholder);
+            glTextureStorage3D(placeholder, 1, GL_RGBA8, 1, 1, 1);
+            glTextureSubImage3D(placeholder, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, black);
+            for (unsigned int i : failed)
+            {
+                Texture& texture = textures_loaded[i];
+                glDeleteTextures(1, &texture.id);
+                packed[texture.id] = texture;
+                Texture& layered = packed[texture.id];
+                layered.id = placeholder;
+                layered.target = GL_TEXTURE_2D_ARRAY;
+                layered.layer = 0;
+                texture = layered;
+            }
+        }
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                map<unsigned int, Texture>::iterator layered = packed.find(meshes[i].textures[j].id);
+                if (layered != packed.end())
+                    meshes[i].textures[j] = layered->second;
+            }
+        }
+        stable_sort(meshes.begin(), meshes.end(), [](const Mesh& a, const Mesh& b) {
+            for (unsigned int i = 0; i < a.textures.size() && i < b.textures.size(); i++)
+            {
+                if (a.textures[i].id != b.textures[i].id)
+                    return a.textures[i].id < b.textures[i].id;
+            }
+            return a.textures.size() < b.textures.size();
+        });
+
+        if (importOptions.printStatistics)
+            cout << "MODEL::TEXTURES:: " << packed.size() << " textures packed into " << groups.size() << " arrays, " << failed.size() << " failed to load" << endl;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -171,29 +849,28 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // loads a texture relative to the model directory, unless it has been loaded before
+    Texture loadTexture(const char* path, const string& typeName)
+    {
+        // check if texture was loaded before and if so, return it: skip loading a new texture
+        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if (std::strcmp(textures_loaded[j].path.data(), path) == 0)
+                return textures_loaded[j]; // a texture with the same filepath has already been loaded. (optimization)
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        return texture;
+    }
 };
 
 
@@ -205,8 +882,10 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
+    // decode straight from the mapped file (or pack archive entry) instead of through stdio reads
     int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    AssetFile file(filename);
+    unsigned char* data = file.IsOpen() ? stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.GetData()), static_cast<int>(file.GetSize()), &width, &height, &nrComponents, 0) : nullptr;
     if (data)
     {
         GLenum format;
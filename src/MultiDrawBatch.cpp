@@ -0,0 +1,93 @@
+#include "MultiDrawBatch.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+#include "UploadRing.h"
+
+MultiDrawBatch::MultiDrawBatch(UploadRing& ring) : ring(ring), calls(0) {
+}
+
+void MultiDrawBatch::Clear() {
+	entries.clear();
+	materialRanks.clear();
+}
+
+void MultiDrawBatch::Add(const void* material, unsigned int indexType, unsigned int indexCount, size_t indexByteOffset, int baseVertex, const DrawData& data) {
+
+	std::map<const void*, unsigned int>::iterator rank = materialRanks.find(material);
+	if (rank == materialRanks.end())
+		rank = materialRanks.insert(std::make_pair(material, static_cast<unsigned int>(materialRanks.size()))).first;
+
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	Entry entry;
+	entry.material = material;
+	entry.materialRank = rank->second;
+	entry.indexType = indexType;
+	entry.command.count = indexCount;
+	entry.command.instanceCount = 1;
+	entry.command.firstIndex = static_cast<unsigned int>(indexByteOffset / indexSize);
+	entry.command.baseVertex = baseVertex;
+	entry.command.baseInstance = 0;
+	entry.data = data;
+	entries.push_back(entry);
+}
+
+void MultiDrawBatch::Draw(const std::function<void(const void* material)>& bindMaterial) {
+
+	calls = 0;
+	if (entries.empty())
+		return;
+
+	order.resize(entries.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		if (entries[a].materialRank != entries[b].materialRank)
+			return entries[a].materialRank < entries[b].materialRank;
+		return entries[a].indexType < entries[b].indexType;
+	});
+
+	// gl_DrawID restarts at 0 with every call, the data of a call is bound as its own range of the buffer.
+	// ranges have to start at a multiple of the offset alignment, the data is padded up to it between calls
+	GLint alignment = 16;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	runs.clear();
+	commands.clear();
+	drawData.clear();
+	for (size_t i = 0; i < order.size(); ++i) {
+		const Entry& entry = entries[order[i]];
+		bool newRun = i == 0 || entry.material != entries[order[i - 1]].material || entry.indexType != entries[order[i - 1]].indexType;
+		if (newRun) {
+			while ((drawData.size() * sizeof(DrawData)) % alignment != 0)
+				drawData.push_back(DrawData());
+			Run run = { commands.size(), 0, drawData.size() };
+			runs.push_back(run);
+		}
+		commands.push_back(entry.command);
+		drawData.push_back(entry.data);
+		runs.back().count++;
+	}
+
+	UploadRing::Allocation commandAllocation = ring.Allocate(commands.size() * sizeof(Command), sizeof(unsigned int));
+	UploadRing::Allocation dataAllocation = ring.AllocateStorage(drawData.size() * sizeof(DrawData));
+	if (!commandAllocation.data || !dataAllocation.data)
+		return;
+	memcpy(commandAllocation.data, commands.data(), commandAllocation.size);
+	memcpy(dataAllocation.data, drawData.data(), dataAllocation.size);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandAllocation.buffer);
+	const void* bound = nullptr;
+	for (size_t i = 0; i < runs.size(); ++i) {
+		const Entry& first = entries[order[runs[i].first]];
+		if (i == 0 || first.material != bound) {
+			bindMaterial(first.material);
+			bound = first.material;
+		}
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kDrawDataBinding, dataAllocation.buffer, dataAllocation.offset + runs[i].dataFirst * sizeof(DrawData),
+			runs[i].count * sizeof(DrawData));
+		glMultiDrawElementsIndirect(GL_TRIANGLES, first.indexType, (const void*)(commandAllocation.offset + runs[i].first * sizeof(Command)),
+			static_cast<GLsizei>(runs[i].count), 0);
+		calls++;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <vector>
+#include "glm/mat4x4.hpp"
+
+class UploadRing;
+
+// Indexed draws out of one vertex array (a GeometryArena) collected per frame and issued with glMultiDrawElementsIndirect:
+// one call for every material and index type, however many draws share them. what differs between the draws of a call
+// is read by the shaders from a storage buffer indexed with gl_DrawIDARB (1.model_loading_indirect.vs).
+class MultiDrawBatch {
+public:
+	// SSBO binding of the per-draw data
+	static const unsigned int kDrawDataBinding = 4;
+
+	// std430 layout of DrawData in the shaders
+	struct DrawData {
+		glm::mat4 model;
+		// texture array layers of texture_diffuse1, texture_specular1, texture_normal1 and texture_height1
+		int layers[4];
+	};
+
+	// the commands and the draw data of every frame are written into ring
+	explicit MultiDrawBatch(UploadRing& ring);
+	MultiDrawBatch(const MultiDrawBatch&) = delete;
+	MultiDrawBatch& operator=(const MultiDrawBatch&) = delete;
+
+	void Clear();
+	// queues indexCount indices of indexType (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) starting indexByteOffset bytes into the
+	// element buffer. material is handed back to the bind function of Draw, draws with the same one share its binding
+	void Add(const void* material, unsigned int indexType, unsigned int indexCount, size_t indexByteOffset, int baseVertex, const DrawData& data);
+
+	// uploads the commands and the draw data and issues them, the VAO and the program have to be bound.
+	// bindMaterial runs before the calls of every material
+	void Draw(const std::function<void(const void* material)>& bindMaterial);
+
+	size_t GetDrawCount() const { return entries.size(); }
+	// glMultiDrawElementsIndirect calls of the last Draw
+	unsigned int GetCallCount() const { return calls; }
+
+private:
+	// same layout as DrawElementsIndirectCommand
+	struct Command {
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+	struct Entry {
+		const void* material;
+		unsigned int materialRank;
+		unsigned int indexType;
+		Command command;
+		DrawData data;
+	};
+
+	std::vector<Entry> entries;
+	// materials in the order they were first added, so Draw keeps the submission order between them
+	std::map<const void*, unsigned int> materialRanks;
+	// draws sharing material and index type, one call each
+	struct Run {
+		size_t first, count, dataFirst;
+	};
+
+	std::vector<unsigned int> order;
+	std::vector<Run> runs;
+	std::vector<Command> commands;
+	std::vector<DrawData> drawData;
+	UploadRing& ring;
+	unsigned int calls;
+};
@@ -0,0 +1,507 @@
+#include "ObjLoader.h"
+#include "AssetFile.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "glm/geometric.hpp"
+#include "JobSystem.h"
+
+namespace {
+
+	// files aren't split into chunks smaller than this, a job per few lines costs more than it saves
+	const size_t kMinChunkBytes = 256 * 1024;
+	// corner slot without a uv or normal
+	const int kNoIndex = INT_MIN;
+	// negative OBJ indices count back from the last vertex read so far, which a chunk only knows relative to its own start.
+	// they are stored as (index within the chunk - kRelative) until the counts of the previous chunks are known
+	const int kRelative = 1 << 30;
+
+	const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// everything read from one line aligned range of the file
+	struct ObjChunk {
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<float> normals;
+		// position, uv and normal index of every triangle corner
+		std::vector<int> corners;
+		// usemtl statements and the first triangle of the chunk they apply to
+		std::vector<std::pair<size_t, std::string>> materials;
+		std::vector<std::string> libraries;
+		size_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+		bool valid = true;
+	};
+
+	bool isSpace(char c) {
+		return c == ' ' || c == '\t';
+	}
+
+	bool isLineEnd(char c) {
+		return c == '\n' || c == '\r';
+	}
+
+	bool isDigit(char c) {
+		return unsigned(c - '0') < 10;
+	}
+
+	const char* skipSpace(const char* p, const char* end) {
+		while (p < end && isSpace(*p))
+			p++;
+		return p;
+	}
+
+	const char* skipLine(const char* p, const char* end) {
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		return newline ? newline + 1 : end;
+	}
+
+	bool startsWith(const char* p, const char* end, const char* keyword) {
+		size_t length = strlen(keyword);
+		return size_t(end - p) > length && memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+	}
+
+	// the rest of the line without surrounding whitespace
+	std::string restOfLine(const char* p, const char* end) {
+		p = skipSpace(p, end);
+		const char* last = p;
+		while (last < end && !isLineEnd(*last))
+			last++;
+		while (last > p && isSpace(last[-1]))
+			last--;
+		return std::string(p, last);
+	}
+
+	// the last whitespace separated token of the line, which skips options like "-bm 0.5" in front of MTL file names
+	std::string lastToken(const char* p, const char* end) {
+		std::string rest = restOfLine(p, end);
+		size_t space = rest.find_last_of(" \t");
+		return space == std::string::npos ? rest : rest.substr(space + 1);
+	}
+
+	// strtof without locale lookups or a null terminator. up to 19 significant digits are kept and scaled
+	// by an exact power of ten in double precision, which is correctly rounded for anything a float can hold
+	const char* parseFloat(const char* p, const char* end, float& result) {
+		p = skipSpace(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		uint64_t mantissa = 0;
+		int digits = 0, exponent = 0;
+		for (; p < end && isDigit(*p); ++p) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+				exponent++;
+		}
+		if (p < end && *p == '.') {
+			for (++p; p < end && isDigit(*p); ++p) {
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* q = p + 1;
+			bool negativeExponent = false;
+			if (q < end && (*q == '-' || *q == '+'))
+				negativeExponent = *q++ == '-';
+			if (q < end && isDigit(*q)) {
+				int value = 0;
+				for (; q < end && isDigit(*q); ++q)
+					value = std::min(value * 10 + (*q - '0'), 10000);
+				exponent += negativeExponent ? -value : value;
+				p = q;
+			}
+		}
+
+		double value = double(mantissa);
+		if (exponent < 0)
+			value = exponent >= -22 ? value / powersOf10[-exponent] : value * pow(10.0, exponent);
+		else if (exponent > 0)
+			value = exponent <= 22 ? value * powersOf10[exponent] : value * pow(10.0, exponent);
+		result = float(negative ? -value : value);
+		return p;
+	}
+
+	// returns p unchanged when there is no number
+	const char* parseInt(const char* p, const char* end, int& result) {
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+		if (p == end || !isDigit(*p))
+			return start;
+		int value = 0;
+		for (; p < end && isDigit(*p); ++p)
+			value = value * 10 + (*p - '0');
+		result = negative ? -value : value;
+		return p;
+	}
+
+	// one "v", "v/vt", "v//vn" or "v/vt/vn" group of a face, counts are the vertices read by this chunk so far
+	const char* parseCorner(const char* p, const char* end, const size_t counts[3], int corner[3]) {
+		corner[0] = corner[1] = corner[2] = kNoIndex;
+		for (int k = 0; k < 3; ++k) {
+			if (k > 0) {
+				if (p == end || *p != '/')
+					break;
+				++p;
+			}
+			int value;
+			const char* next = parseInt(p, end, value);
+			if (next == p)
+				continue;
+			p = next;
+			if (value > 0)
+				corner[k] = value - 1;
+			else if (value < 0)
+				corner[k] = int(counts[k]) + value - kRelative;
+			else
+				corner[k] = INT_MAX; // index 0 doesn't exist, fails the range check later
+		}
+		return p;
+	}
+
+	void parseChunk(ObjChunk& chunk, const char* p, const char* end) {
+
+		std::vector<int> face;
+		while (p < end) {
+			p = skipSpace(p, end);
+			if (p == end)
+				break;
+
+			if (p[0] == 'v' && end - p > 1) {
+				float value[3];
+				if (isSpace(p[1])) {
+					p = parseFloat(parseFloat(parseFloat(p + 1, end, value[0]), end, value[1]), end, value[2]);
+					chunk.positions.insert(chunk.positions.end(), value, value + 3);
+				}
+				else if (p[1] == 't' && end - p > 2 && isSpace(p[2])) {
+					p = parseFloat(parseFloat(p + 2, end, value[0]), end, value[1]);
+					chunk.texCoords.insert(chunk.texCoords.end(), value, value + 2);
+				}
+				else if (p[1] == 'n' && end - p > 2 && isSpace(p[2])) {
+					p = parseFloat(parseFloat(parseFloat(p + 2, end, value[0]), end, value[1]), end, value[2]);
+					chunk.normals.insert(chunk.normals.end(), value, value + 3);
+				}
+			}
+			else if (p[0] == 'f' && end - p > 1 && isSpace(p[1])) {
+				size_t counts[3] = { chunk.positions.size() / 3, chunk.texCoords.size() / 2, chunk.normals.size() / 3 };
+				face.clear();
+				p++;
+				for (;;) {
+					p = skipSpace(p, end);
+					if (p == end || isLineEnd(*p) || *p == '#')
+						break;
+					int corner[3];
+					const char* next = parseCorner(p, end, counts, corner);
+					if (next == p)
+						break;
+					p = next;
+					face.insert(face.end(), corner, corner + 3);
+				}
+				// polygons become triangle fans, like aiProcess_Triangulate does for convex faces
+				size_t cornerCount = face.size() / 3;
+				for (size_t i = 2; i < cornerCount; ++i) {
+					chunk.corners.insert(chunk.corners.end(), face.begin(), face.begin() + 3);
+					chunk.corners.insert(chunk.corners.end(), face.begin() + (i - 1) * 3, face.begin() + (i + 1) * 3);
+				}
+			}
+			else if (startsWith(p, end, "usemtl"))
+				chunk.materials.push_back(std::make_pair(chunk.corners.size() / 9, restOfLine(p + 6, end)));
+			else if (startsWith(p, end, "mtllib"))
+				chunk.libraries.push_back(restOfLine(p + 6, end));
+
+			p = skipLine(p, end);
+		}
+	}
+
+	// turns the corner indices of a chunk into global ones and checks them against the global vertex counts.
+	// uvs and normals are optional, a corner without a position ("f /1/1 ...") makes the chunk invalid
+	void resolveChunk(ObjChunk& chunk, const size_t totals[3]) {
+		const size_t bases[3] = { chunk.positionBase, chunk.texCoordBase, chunk.normalBase };
+		for (size_t i = 0; i < chunk.corners.size(); ++i) {
+			int& index = chunk.corners[i];
+			size_t k = i % 3;
+			if (index == kNoIndex) {
+				if (k == 0) {
+					chunk.valid = false;
+					return;
+				}
+				continue;
+			}
+			long long global = index < 0 ? (long long)bases[k] + index + kRelative : index;
+			if (global < 0 || global >= (long long)totals[k]) {
+				chunk.valid = false;
+				return;
+			}
+			index = int(global);
+		}
+	}
+
+	struct CornerKey {
+		int position, texCoord, normal;
+	};
+
+	// creates the vertices of one material: every distinct position/uv/normal combination once
+	void buildMesh(ObjMesh& mesh, const std::vector<int>& corners, const std::vector<float>& positions,
+		const std::vector<float>& texCoords, const std::vector<float>& normals) {
+
+		size_t cornerCount = corners.size() / 3;
+		// the vertices made from a position are chained from it. a position rarely has more than a few uv/normal
+		// variants and faces reference positions in file order, which keeps this a mostly sequential walk
+		std::vector<unsigned int> first(positions.size() / 3, ~0u);
+		std::vector<unsigned int> next;
+		std::vector<CornerKey> keys;
+		keys.reserve(cornerCount / 2);
+		next.reserve(cornerCount / 2);
+		mesh.vertices.reserve(cornerCount / 2);
+		mesh.indices.resize(cornerCount);
+
+		bool hasTexCoords = false, missingNormals = false;
+		for (size_t i = 0; i < cornerCount; ++i) {
+			CornerKey key = { corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2] };
+			unsigned int index = first[key.position];
+			while (index != ~0u && (keys[index].texCoord != key.texCoord || keys[index].normal != key.normal))
+				index = next[index];
+			if (index == ~0u) {
+				index = unsigned(keys.size());
+				next.push_back(first[key.position]);
+				first[key.position] = index;
+				keys.push_back(key);
+
+				Vertex vertex = {};
+				vertex.Position = glm::vec3(positions[key.position * 3], positions[key.position * 3 + 1], positions[key.position * 3 + 2]);
+				if (key.texCoord != kNoIndex) {
+					vertex.TexCoords = glm::vec2(texCoords[key.texCoord * 2], 1.0f - texCoords[key.texCoord * 2 + 1]);
+					hasTexCoords = true;
+				}
+				if (key.normal != kNoIndex)
+					vertex.Normal = glm::vec3(normals[key.normal * 3], normals[key.normal * 3 + 1], normals[key.normal * 3 + 2]);
+				else
+					missingNormals = true;
+				mesh.vertices.push_back(vertex);
+			}
+			mesh.indices[i] = index;
+		}
+
+		std::vector<Vertex>& vertices = mesh.vertices;
+		const std::vector<unsigned int>& indices = mesh.indices;
+
+		// smooth normals for vertices without one, averaged over all faces around the position (weighted by area)
+		if (missingNormals) {
+			// accumulated on the first vertex of every position, which the chains above lead to
+			std::vector<glm::vec3> smooth(vertices.size(), glm::vec3(0.0f));
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				const glm::vec3& p0 = vertices[indices[i]].Position;
+				glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+				for (int k = 0; k < 3; ++k)
+					smooth[first[keys[indices[i + k]].position]] += normal;
+			}
+			for (size_t v = 0; v < vertices.size(); ++v) {
+				if (keys[v].normal != kNoIndex)
+					continue;
+				glm::vec3 normal = smooth[first[keys[v].position]];
+				float length = glm::length(normal);
+				vertices[v].Normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			}
+		}
+
+		// tangent space from the uv gradients of the faces, like aiProcess_CalcTangentSpace
+		if (hasTexCoords) {
+			std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f)), bitangents(vertices.size(), glm::vec3(0.0f));
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				const Vertex& v0 = vertices[indices[i]];
+				const Vertex& v1 = vertices[indices[i + 1]];
+				const Vertex& v2 = vertices[indices[i + 2]];
+				glm::vec3 e1 = v1.Position - v0.Position, e2 = v2.Position - v0.Position;
+				glm::vec2 d1 = v1.TexCoords - v0.TexCoords, d2 = v2.TexCoords - v0.TexCoords;
+				float determinant = d1.x * d2.y - d2.x * d1.y;
+				if (fabsf(determinant) < 1e-12f)
+					continue;
+				float inverse = 1.0f / determinant;
+				glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * inverse;
+				glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) * inverse;
+				for (int k = 0; k < 3; ++k) {
+					tangents[indices[i + k]] += tangent;
+					bitangents[indices[i + k]] += bitangent;
+				}
+			}
+			for (size_t v = 0; v < vertices.size(); ++v) {
+				const glm::vec3& normal = vertices[v].Normal;
+				glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]);
+				float length = glm::length(tangent);
+				if (length < 1e-12f) {
+					// no usable uv gradient, any direction in the tangent plane will do
+					tangent = glm::cross(normal, fabsf(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+					length = glm::length(tangent);
+					if (length < 1e-12f)
+						continue;
+				}
+				tangent /= length;
+				glm::vec3 bitangent = glm::cross(normal, tangent);
+				if (glm::dot(bitangent, bitangents[v]) < 0.0f)
+					bitangent = -bitangent;
+				vertices[v].Tangent = tangent;
+				vertices[v].Bitangent = bitangent;
+			}
+		}
+	}
+
+	std::string directoryOf(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+}
+
+const ObjMaterial* ObjModel::FindMaterial(const std::string& name) const {
+	for (const ObjMaterial& material : materials)
+		if (material.name == name)
+			return &material;
+	return nullptr;
+}
+
+bool geometry::loadObj(ObjModel& model, const std::string& path, unsigned int threadCount) {
+
+	AssetFile file(path);
+	if (!file.IsOpen()) {
+		std::cout << "ERROR::OBJ:: can't open " << path << std::endl;
+		return false;
+	}
+	const char* data = file.GetData();
+	const char* end = data + file.GetSize();
+
+	JobSystem& jobs = JobSystem::Get();
+	if (threadCount == 0)
+		threadCount = jobs.GetWorkerCount();
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.GetSize() / kMinChunkBytes));
+
+	// 1. parse line aligned chunks in parallel
+	std::vector<const char*> starts(chunkCount + 1, end);
+	starts[0] = data;
+	for (size_t i = 1; i < chunkCount; ++i) {
+		const char* start = std::max(starts[i - 1], data + file.GetSize() * i / chunkCount);
+		starts[i] = start > data && start[-1] != '\n' ? skipLine(start, end) : start;
+	}
+	std::vector<ObjChunk> chunks(chunkCount);
+	jobs.ParallelFor(chunkCount, [&](size_t i, unsigned int) {
+		parseChunk(chunks[i], starts[i], starts[i + 1]);
+	});
+
+	// 2. concatenate the vertex data and resolve the indices against it
+	size_t totals[3] = { 0, 0, 0 };
+	for (ObjChunk& chunk : chunks) {
+		chunk.positionBase = totals[0];
+		chunk.texCoordBase = totals[1];
+		chunk.normalBase = totals[2];
+		totals[0] += chunk.positions.size() / 3;
+		totals[1] += chunk.texCoords.size() / 2;
+		totals[2] += chunk.normals.size() / 3;
+	}
+	std::vector<float> positions(totals[0] * 3), texCoords(totals[1] * 2), normals(totals[2] * 3);
+	jobs.ParallelFor(chunkCount, [&](size_t i, unsigned int) {
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + chunk.texCoordBase * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+		resolveChunk(chunk, totals);
+	});
+	for (const ObjChunk& chunk : chunks) {
+		if (!chunk.valid) {
+			std::cout << "ERROR::OBJ:: " << path << " has a face corner without a position or references a vertex that doesn't exist" << std::endl;
+			return false;
+		}
+	}
+
+	// 3. group the triangles by material, in the order the materials are first used
+	std::vector<std::string> names;
+	std::vector<std::vector<int>> groups;
+	size_t current = 0;
+	auto select = [&](const std::string& name) {
+		current = std::find(names.begin(), names.end(), name) - names.begin();
+		if (current == names.size()) {
+			names.push_back(name);
+			groups.emplace_back();
+		}
+	};
+	select(std::string());
+	std::vector<std::string> libraries;
+	for (ObjChunk& chunk : chunks) {
+		size_t triangle = 0;
+		for (size_t m = 0; m <= chunk.materials.size(); ++m) {
+			size_t until = m < chunk.materials.size() ? chunk.materials[m].first : chunk.corners.size() / 9;
+			groups[current].insert(groups[current].end(), chunk.corners.begin() + triangle * 9, chunk.corners.begin() + until * 9);
+			triangle = until;
+			if (m < chunk.materials.size())
+				select(chunk.materials[m].second);
+		}
+		for (const std::string& library : chunk.libraries)
+			if (std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+				libraries.push_back(library);
+		chunk = ObjChunk();
+	}
+
+	// 4. build the vertex and index buffers of all materials in parallel
+	size_t firstMesh = model.meshes.size();
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (groups[i].empty())
+			continue;
+		model.meshes.emplace_back();
+		model.meshes.back().material = names[i];
+	}
+	std::vector<size_t> groupOfMesh;
+	for (size_t i = 0; i < groups.size(); ++i)
+		if (!groups[i].empty())
+			groupOfMesh.push_back(i);
+	jobs.ParallelFor(groupOfMesh.size(), [&](size_t i, unsigned int) {
+		buildMesh(model.meshes[firstMesh + i], groups[groupOfMesh[i]], positions, texCoords, normals);
+	});
+
+	std::string directory = directoryOf(path);
+	for (const std::string& library : libraries)
+		if (!loadMtl(model.materials, directory + library))
+			std::cout << "ERROR::OBJ:: can't open material library " << directory + library << std::endl;
+	return true;
+}
+
+bool geometry::loadMtl(std::vector<ObjMaterial>& materials, const std::string& path) {
+
+	AssetFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	ObjMaterial* material = nullptr;
+	const char* end = file.GetData() + file.GetSize();
+	for (const char* p = file.GetData(); p < end; p = skipLine(p, end)) {
+		p = skipSpace(p, end);
+		if (startsWith(p, end, "newmtl")) {
+			materials.emplace_back();
+			material = &materials.back();
+			material->name = restOfLine(p + 6, end);
+		}
+		else if (!material)
+			continue;
+		else if (startsWith(p, end, "map_Kd"))
+			material->diffuseMap = lastToken(p + 6, end);
+		else if (startsWith(p, end, "map_Ks"))
+			material->specularMap = lastToken(p + 6, end);
+		else if (startsWith(p, end, "map_Ka"))
+			material->heightMap = lastToken(p + 6, end);
+		else if (startsWith(p, end, "map_Bump") || startsWith(p, end, "map_bump"))
+			material->normalMap = lastToken(p + 8, end);
+		else if (startsWith(p, end, "bump"))
+			material->normalMap = lastToken(p + 4, end);
+	}
+	return true;
+}
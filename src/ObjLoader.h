@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Vertex.h"
+
+// texture file names of an MTL material, relative to the directory of the model.
+// the slots follow what ASSIMP reports for these keys: map_Kd diffuse, map_Ks specular, map_Bump/bump height
+// (loaded as the normal map by Model) and map_Ka ambient (loaded as the height map).
+struct ObjMaterial {
+	std::string name;
+	std::string diffuseMap;
+	std::string specularMap;
+	std::string normalMap;
+	std::string heightMap;
+};
+
+// all triangles of one material, with vertices deduplicated over their position/uv/normal indices
+struct ObjMesh {
+	std::string material;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
+
+struct ObjModel {
+	std::vector<ObjMesh> meshes;
+	std::vector<ObjMaterial> materials;
+
+	const ObjMaterial* FindMaterial(const std::string& name) const;
+};
+
+// Wavefront OBJ reader for the common subset (v, vt, vn, f, usemtl, mtllib) that replaces ASSIMP for .obj models.
+// the file is memory mapped (or taken from the mounted pack archive) and split into up to threadCount line aligned chunks that are parsed
+// as jobs of the JobSystem (0 = one per worker), polygons are fanned into triangles and uvs are flipped like aiProcess_FlipUVs.
+// missing normals are generated smooth per position and tangents/bitangents are computed when there are uvs.
+namespace geometry {
+
+	// returns false and prints the reason when the file can't be read, has face corners without a position or references
+	// vertices it doesn't have
+	bool loadObj(ObjModel& model, const std::string& path, unsigned int threadCount = 0);
+
+	// appends the materials of an MTL file, returns false when it can't be opened
+	bool loadMtl(std::vector<ObjMaterial>& materials, const std::string& path);
+}
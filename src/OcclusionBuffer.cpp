@@ -0,0 +1,228 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+namespace {
+
+	// w below this counts as behind the camera
+	const float kNearW = 1e-4f;
+
+	// in front of the near plane (GL clip space, -w <= z). anything nearer is clipped away by the GPU, its depth after
+	// the divide would be below 0 and hide everything
+	bool beyondNear(const glm::vec4& clip) {
+		return clip.w >= kNearW && clip.z >= -clip.w;
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) : viewProjection(1.0f) {
+	tilesX = std::max((width + kTileWidth - 1) / kTileWidth, 1);
+	tilesY = std::max((height + kTileHeight - 1) / kTileHeight, 1);
+	this->width = tilesX * kTileWidth;
+	this->height = tilesY * kTileHeight;
+	depth.assign(this->width * this->height, 1.0f);
+	tileDepth.assign(tilesX * tilesY, 1.0f);
+	bins.resize(tilesY);
+}
+
+void OcclusionBuffer::Begin(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+	triangles.clear();
+	for (std::vector<unsigned int>& bin : bins)
+		bin.clear();
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileDepth.begin(), tileDepth.end(), 1.0f);
+}
+
+void OcclusionBuffer::AddOccluder(const glm::vec3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount, const glm::mat4& model) {
+
+	glm::mat4 transform = viewProjection * model;
+	projected.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+		projected[i] = transform * glm::vec4(positions[i], 1.0f);
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		const glm::vec4* corners[3] = { &projected[indices[i]], &projected[indices[i + 1]], &projected[indices[i + 2]] };
+		if (!beyondNear(*corners[0]) || !beyondNear(*corners[1]) || !beyondNear(*corners[2]))
+			continue;
+
+		Triangle triangle;
+		for (int c = 0; c < 3; ++c) {
+			float inverseW = 1.0f / corners[c]->w;
+			triangle.x[c] = (corners[c]->x * inverseW * 0.5f + 0.5f) * width;
+			triangle.y[c] = (corners[c]->y * inverseW * 0.5f + 0.5f) * height;
+			triangle.z[c] = corners[c]->z * inverseW * 0.5f + 0.5f;
+		}
+		float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+		float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+		float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+		float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+		float minZ = std::min(triangle.z[0], std::min(triangle.z[1], triangle.z[2]));
+		if (maxX < 0.0f || minX > width || maxY < 0.0f || minY > height || minZ > 1.0f)
+			continue;
+
+		unsigned int index = static_cast<unsigned int>(triangles.size());
+		triangles.push_back(triangle);
+		int firstRow = std::max(static_cast<int>(minY) / kTileHeight, 0);
+		int lastRow = std::min(static_cast<int>(maxY) / kTileHeight, tilesY - 1);
+		for (int row = firstRow; row <= lastRow; ++row)
+			bins[row].push_back(index);
+	}
+}
+
+void OcclusionBuffer::Rasterize() {
+	// rows of tiles share no pixels, every job owns the rows it takes
+	JobSystem::Get().ParallelFor(tilesY, [&](size_t row, unsigned int) {
+		rasterizeRow(static_cast<int>(row));
+	}, 1);
+}
+
+void OcclusionBuffer::rasterizeRow(int row) {
+
+	int minY = row * kTileHeight, maxY = minY + kTileHeight;
+	for (unsigned int index : bins[row])
+		rasterizeTriangle(triangles[index], minY, maxY);
+
+	for (int tile = 0; tile < tilesX; ++tile) {
+		float farthest = 0.0f;
+		for (int y = minY; y < maxY; ++y) {
+			const float* line = &depth[y * width + tile * kTileWidth];
+#if defined(OCCLUSION_SSE)
+			__m128 maximum = _mm_loadu_ps(line);
+			for (int x = 4; x < kTileWidth; x += 4)
+				maximum = _mm_max_ps(maximum, _mm_loadu_ps(line + x));
+			maximum = _mm_max_ps(maximum, _mm_movehl_ps(maximum, maximum));
+			maximum = _mm_max_ss(maximum, _mm_shuffle_ps(maximum, maximum, 1));
+			farthest = std::max(farthest, _mm_cvtss_f32(maximum));
+#else
+			for (int x = 0; x < kTileWidth; ++x)
+				farthest = std::max(farthest, line[x]);
+#endif
+		}
+		tileDepth[row * tilesX + tile] = farthest;
+	}
+}
+
+// edge functions at the pixel centers of the triangle's bounding rectangle within rows minY..maxY,
+// covered pixels keep the nearer of their depth and the triangle's depth plane
+void OcclusionBuffer::rasterizeTriangle(const Triangle& triangle, int minY, int maxY) {
+
+	float x0 = triangle.x[0], y0 = triangle.y[0], z0 = triangle.z[0];
+	float x1 = triangle.x[1], y1 = triangle.y[1], z1 = triangle.z[1];
+	float x2 = triangle.x[2], y2 = triangle.y[2], z2 = triangle.z[2];
+	float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (area == 0.0f)
+		return;
+	// occluders have no back faces, wind every triangle the same way
+	if (area < 0.0f) {
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(z1, z2);
+		area = -area;
+	}
+
+	int left = std::max(static_cast<int>(floorf(std::min(x0, std::min(x1, x2)))), 0) & ~3;
+	int right = std::min(static_cast<int>(ceilf(std::max(x0, std::max(x1, x2)))), width);
+	int top = std::max(static_cast<int>(floorf(std::min(y0, std::min(y1, y2)))), minY);
+	int bottom = std::min(static_cast<int>(ceilf(std::max(y0, std::max(y1, y2)))), maxY);
+	if (left >= right || top >= bottom)
+		return;
+
+	// edge i is positive on the inner side: e(x, y) = a * x + b * y + c
+	float a[3] = { y0 - y1, y1 - y2, y2 - y0 };
+	float b[3] = { x1 - x0, x2 - x1, x0 - x2 };
+	float c[3] = { -(a[0] * x0 + b[0] * y0), -(a[1] * x1 + b[1] * y1), -(a[2] * x2 + b[2] * y2) };
+	float dzdx = ((z1 - z0) * (y2 - y0) - (z2 - z0) * (y1 - y0)) / area;
+	float dzdy = ((z2 - z0) * (x1 - x0) - (z1 - z0) * (x2 - x0)) / area;
+	float zc = z0 - dzdx * x0 - dzdy * y0;
+
+#if defined(OCCLUSION_SSE)
+	__m128 zero = _mm_setzero_ps();
+	__m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	__m128 stepA[3], stepZ = _mm_set1_ps(dzdx * 4.0f);
+	for (int e = 0; e < 3; ++e)
+		stepA[e] = _mm_set1_ps(a[e] * 4.0f);
+	for (int y = top; y < bottom; ++y) {
+		float py = y + 0.5f;
+		__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(left)), laneOffsets);
+		__m128 edge[3];
+		for (int e = 0; e < 3; ++e)
+			edge[e] = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a[e])), _mm_set1_ps(b[e] * py + c[e]));
+		__m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(dzdx)), _mm_set1_ps(dzdy * py + zc));
+		float* line = &depth[y * width];
+		for (int x = left; x < right; x += 4) {
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+			if (_mm_movemask_ps(inside)) {
+				__m128 current = _mm_loadu_ps(line + x);
+				__m128 nearer = _mm_min_ps(current, z);
+				_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+			}
+			for (int e = 0; e < 3; ++e)
+				edge[e] = _mm_add_ps(edge[e], stepA[e]);
+			z = _mm_add_ps(z, stepZ);
+		}
+	}
+#else
+	for (int y = top; y < bottom; ++y) {
+		float py = y + 0.5f;
+		float* line = &depth[y * width];
+		for (int x = left; x < right; ++x) {
+			float px = x + 0.5f;
+			if (a[0] * px + b[0] * py + c[0] >= 0.0f && a[1] * px + b[1] * py + c[1] >= 0.0f && a[2] * px + b[2] * py + c[2] >= 0.0f)
+				line[x] = std::min(line[x], dzdx * px + dzdy * py + zc);
+		}
+	}
+#endif
+}
+
+bool OcclusionBuffer::IsBoxVisible(const glm::vec3& minimum, const glm::vec3& maximum) const {
+
+	float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f, nearest = 1.0f;
+	for (int corner = 0; corner < 8; ++corner) {
+		glm::vec3 position((corner & 1) ? maximum.x : minimum.x, (corner & 2) ? maximum.y : minimum.y, (corner & 4) ? maximum.z : minimum.z);
+		glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+		if (!beyondNear(clip))
+			return true;
+		float inverseW = 1.0f / clip.w;
+		minX = std::min(minX, clip.x * inverseW);
+		maxX = std::max(maxX, clip.x * inverseW);
+		minY = std::min(minY, clip.y * inverseW);
+		maxY = std::max(maxY, clip.y * inverseW);
+		nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+	}
+	return IsRectVisible(static_cast<int>(floorf((minX * 0.5f + 0.5f) * width)), static_cast<int>(floorf((minY * 0.5f + 0.5f) * height)),
+		static_cast<int>(ceilf((maxX * 0.5f + 0.5f) * width)), static_cast<int>(ceilf((maxY * 0.5f + 0.5f) * height)), nearest);
+}
+
+bool OcclusionBuffer::IsRectVisible(int minX, int minY, int maxX, int maxY, float depth) const {
+
+	minX = std::max(minX, 0);
+	minY = std::max(minY, 0);
+	maxX = std::min(maxX, width);
+	maxY = std::min(maxY, height);
+	if (minX >= maxX || minY >= maxY)
+		return false;
+
+	for (int tileY = minY / kTileHeight; tileY <= (maxY - 1) / kTileHeight; ++tileY) {
+		for (int tileX = minX / kTileWidth; tileX <= (maxX - 1) / kTileWidth; ++tileX) {
+			// every pixel of the tile has an occluder in front of the object
+			if (tileDepth[tileY * tilesX + tileX] < depth)
+				continue;
+			int top = std::max(minY, tileY * kTileHeight), bottom = std::min(maxY, (tileY + 1) * kTileHeight);
+			int left = std::max(minX, tileX * kTileWidth), right = std::min(maxX, (tileX + 1) * kTileWidth);
+			for (int y = top; y < bottom; ++y) {
+				const float* line = &this->depth[y * width];
+				for (int x = left; x < right; ++x) {
+					if (line[x] >= depth)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/ext/vector_float3.hpp"
+#include "glm/ext/matrix_float4x4.hpp"
+
+// Low resolution depth buffer the large occluders of a frame are rasterized into on the CPU, so that the boxes of
+// other objects can be tested against it before their draws are issued. the screen is split into tiles of
+// kTileWidth x kTileHeight pixels: every row of tiles is rasterized by its own job, four pixels per SSE step,
+// and keeps the farthest depth of each tile so most box tests never look at single pixels.
+// depth is NDC z / w mapped to 0..1, the buffer stores the nearest occluder per pixel.
+class OcclusionBuffer {
+public:
+	static const int kTileWidth = 32;
+	static const int kTileHeight = 8;
+
+	// width and height are rounded up to whole tiles
+	OcclusionBuffer(int width, int height);
+
+	// clears the buffer and the queued occluders
+	void Begin(const glm::mat4& viewProjection);
+	// projects the triangles of a mesh placed by model and queues them for Rasterize. triangles with a corner in front of
+	// the near plane (clip z < -w) are left out, which only makes the buffer more permissive
+	void AddOccluder(const glm::vec3* positions, size_t vertexCount, const unsigned int* indices, size_t indexCount, const glm::mat4& model);
+	void Rasterize();
+
+	// whether any pixel of the box's screen rectangle isn't covered by an occluder nearer than the box. boxes that cross
+	// the near plane are always visible, boxes entirely off screen never
+	bool IsBoxVisible(const glm::vec3& minimum, const glm::vec3& maximum) const;
+	// rectangle in pixels (exclusive maximum), depth is the nearest depth of the object inside it
+	bool IsRectVisible(int minX, int minY, int maxX, int maxY, float depth) const;
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const float* GetDepth() const { return depth.data(); }
+	size_t GetTriangleCount() const { return triangles.size(); }
+
+private:
+	// screen space corners in pixels with their depth
+	struct Triangle {
+		float x[3], y[3], z[3];
+	};
+
+	int width, height;
+	int tilesX, tilesY;
+	glm::mat4 viewProjection;
+	std::vector<float> depth;
+	// farthest depth of every tile
+	std::vector<float> tileDepth;
+	std::vector<Triangle> triangles;
+	// triangles overlapping each row of tiles
+	std::vector<std::vector<unsigned int> > bins;
+	// clip space positions of AddOccluder, reused
+	std::vector<glm::vec4> projected;
+
+	void rasterizeRow(int row);
+	void rasterizeTriangle(const Triangle& triangle, int minY, int maxY);
+};
@@ -0,0 +1,90 @@
+#include "PackArchive.h"
+#include <algorithm>
+#include <cstring>
+#include "Lz4.h"
+
+namespace {
+	PackArchive mountedArchive;
+}
+
+PackArchive::PackArchive() : header(nullptr), entries(nullptr), paths(nullptr) {
+}
+
+bool PackArchive::Open(const std::string& path) {
+	Close();
+	if (!file.Open(path) || file.GetSize() < sizeof(pack::Header))
+		return false;
+
+	const char* data = file.GetData();
+	uint64_t size = file.GetSize();
+	const pack::Header* candidate = reinterpret_cast<const pack::Header*>(data);
+	bool valid = candidate->magic == pack::kMagic && candidate->version == pack::kVersion
+		&& candidate->indexOffset % alignof(pack::Entry) == 0
+		&& candidate->indexOffset <= size && candidate->entryCount <= (size - candidate->indexOffset) / sizeof(pack::Entry)
+		&& candidate->pathsOffset <= size && candidate->pathsSize <= size - candidate->pathsOffset;
+	if (valid) {
+		const pack::Entry* index = reinterpret_cast<const pack::Entry*>(data + candidate->indexOffset);
+		for (uint32_t i = 0; i < candidate->entryCount && valid; ++i) {
+			const pack::Entry& entry = index[i];
+			valid = entry.offset <= size && entry.storedSize <= size - entry.offset
+				&& entry.pathOffset <= candidate->pathsSize && entry.pathLength <= candidate->pathsSize - entry.pathOffset
+				&& (i == 0 || index[i - 1].pathHash <= entry.pathHash)
+				&& ((entry.flags & pack::kFlagLz4) || entry.storedSize == entry.size);
+		}
+	}
+	if (!valid) {
+		file.Close();
+		return false;
+	}
+
+	header = candidate;
+	entries = reinterpret_cast<const pack::Entry*>(data + header->indexOffset);
+	paths = data + header->pathsOffset;
+	return true;
+}
+
+void PackArchive::Close() {
+	file.Close();
+	header = nullptr;
+	entries = nullptr;
+	paths = nullptr;
+}
+
+const pack::Entry* PackArchive::Find(const std::string& path) const {
+	if (!header)
+		return nullptr;
+
+	std::string normalized = pack::normalizePath(path);
+	uint64_t hash = pack::hashPath(normalized);
+	const pack::Entry* end = entries + header->entryCount;
+	const pack::Entry* entry = std::lower_bound(entries, end, hash, [](const pack::Entry& e, uint64_t h) { return e.pathHash < h; });
+	// the packer refuses colliding hashes, the compare only guards against paths that aren't in the archive
+	for (; entry != end && entry->pathHash == hash; ++entry) {
+		if (entry->pathLength == normalized.size() && memcmp(paths + entry->pathOffset, normalized.data(), normalized.size()) == 0)
+			return entry;
+	}
+	return nullptr;
+}
+
+const char* PackArchive::GetStoredData(const pack::Entry& entry) const {
+	return file.GetData() + entry.offset;
+}
+
+bool PackArchive::Extract(const pack::Entry& entry, char* destination) const {
+	if (entry.flags & pack::kFlagLz4)
+		return lz4::decompress(destination, size_t(entry.size), GetStoredData(entry), size_t(entry.storedSize));
+	memcpy(destination, GetStoredData(entry), size_t(entry.size));
+	return true;
+}
+
+bool PackArchive::Mount(const std::string& path) {
+	return mountedArchive.Open(path);
+}
+
+void PackArchive::Unmount() {
+	mountedArchive.Close();
+}
+
+const PackArchive* PackArchive::Mounted() {
+	return mountedArchive.IsOpen() ? &mountedArchive : nullptr;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include "MappedFile.h"
+#include "PackFormat.h"
+
+// Read access to a .pak archive. the archive is memory mapped once, the index is searched in place
+// and uncompressed entries are used straight from the mapping.
+class PackArchive {
+public:
+	PackArchive();
+
+	// maps the archive and validates its index, returns false for missing or malformed files
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return header != nullptr; }
+
+	// the entry of a path (normalized before the lookup), nullptr when the archive doesn't contain it
+	const pack::Entry* Find(const std::string& path) const;
+	// the bytes of an entry as stored, LZ4 entries still have to be decoded with Extract
+	const char* GetStoredData(const pack::Entry& entry) const;
+	// writes the decoded entry.size bytes of an entry to destination
+	bool Extract(const pack::Entry& entry, char* destination) const;
+	size_t GetEntryCount() const { return header ? header->entryCount : 0; }
+
+	// the process wide archive AssetFile looks into before the file system
+	static bool Mount(const std::string& path);
+	static void Unmount();
+	static const PackArchive* Mounted();
+
+private:
+	MappedFile file;
+	const pack::Header* header;
+	const pack::Entry* entries;
+	const char* paths;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of .pak archives, written by tools/packer and read by PackArchive.
+// header, entry data (every entry starts on a kAlignment boundary), then the index: Entry records sorted by path hash,
+// followed by the normalized paths, so a lookup is a binary search and one string compare against the mapped file.
+namespace pack {
+
+	const uint32_t kMagic = 0x4b503450; // "P4PK"
+	const uint32_t kVersion = 1;
+	const uint64_t kAlignment = 64;
+	// the entry is one LZ4 block of storedSize bytes that decodes to size bytes
+	const uint32_t kFlagLz4 = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t indexOffset;
+		uint64_t pathsOffset;
+		uint64_t pathsSize;
+	};
+
+	struct Entry {
+		uint64_t pathHash;
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t pathOffset;
+		uint32_t pathLength;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(Header) == 40, "pack::Header is written as is");
+	static_assert(sizeof(Entry) == 48, "pack::Entry is written as is");
+
+	// 64 bit FNV-1a
+	inline uint64_t hashPath(const std::string& path) {
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : path) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// forward slashes, no "." segments, ".." folded into its parent and no repeated slashes:
+	// "res\\models/./house//../house/house.obj" -> "res/models/house/house.obj"
+	inline std::string normalizePath(const std::string& path) {
+		std::vector<std::string> segments;
+		std::string segment;
+		bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+		for (size_t i = 0; i <= path.size(); ++i) {
+			char c = i < path.size() ? path[i] : '/';
+			if (c != '/' && c != '\\') {
+				segment += c;
+				continue;
+			}
+			if (segment == "..") {
+				if (!segments.empty() && segments.back() != "..")
+					segments.pop_back();
+				else
+					segments.push_back(segment);
+			}
+			else if (!segment.empty() && segment != ".")
+				segments.push_back(segment);
+			segment.clear();
+		}
+		std::string normalized = absolute ? "/" : "";
+		for (size_t i = 0; i < segments.size(); ++i) {
+			if (i > 0)
+				normalized += '/';
+			normalized += segments[i];
+		}
+		return normalized;
+	}
+}
@@ -0,0 +1,204 @@
+#include "RenderQueue.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+	const unsigned int kDepthBits = 20;
+	const unsigned int kVaoBits = 12;
+	const unsigned int kMaterialBits = 16;
+	const unsigned int kProgramBits = 12;
+	const unsigned int kPassBits = 4;
+
+	const unsigned int kDepthShift = 0;
+	const unsigned int kVaoShift = kDepthShift + kDepthBits;
+	const unsigned int kMaterialShift = kVaoShift + kVaoBits;
+	const unsigned int kProgramShift = kMaterialShift + kMaterialBits;
+	const unsigned int kPassShift = kProgramShift + kProgramBits;
+
+	static_assert(kPassShift + kPassBits == 64, "the sort key fields fill 64 bits");
+
+	unsigned int field(uint64_t key, unsigned int shift, unsigned int bits) {
+		return unsigned((key >> shift) & ((uint64_t(1) << bits) - 1));
+	}
+
+	// no program, material or VAO is known to be bound
+	const unsigned int kUnknown = ~0u;
+}
+
+RenderQueue::RenderQueue() : sorted(true), stateChanges(0) {
+	programs.push_back(Program{ 0, std::function<void()>() });
+	materials.push_back(std::function<void()>());
+}
+
+unsigned int RenderQueue::AddProgram(unsigned int program, std::function<void()> setup) {
+	if (programs.size() >= (size_t(1) << kProgramBits))
+		return 0;
+	programs.push_back(Program{ program, std::move(setup) });
+	return unsigned(programs.size() - 1);
+}
+
+unsigned int RenderQueue::AddMaterial(std::function<void()> bind) {
+	if (materials.size() >= (size_t(1) << kMaterialBits))
+		return 0;
+	materials.push_back(std::move(bind));
+	return unsigned(materials.size() - 1);
+}
+
+void RenderQueue::SetPassSetup(unsigned int pass, std::function<void()> setup) {
+	if (pass < kPassCount)
+		passSetups[pass] = std::move(setup);
+}
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth) {
+	uint64_t quantizedDepth = uint64_t(std::min(std::max(depth, 0.0f), 1.0f) * float((1 << kDepthBits) - 1));
+	return (uint64_t(pass & ((1u << kPassBits) - 1)) << kPassShift) |
+		(uint64_t(program & ((1u << kProgramBits) - 1)) << kProgramShift) |
+		(uint64_t(material & ((1u << kMaterialBits) - 1)) << kMaterialShift) |
+		// only orders packets, the VAO itself is kept in the packet
+		(uint64_t(vao & ((1u << kVaoBits) - 1)) << kVaoShift) |
+		(quantizedDepth << kDepthShift);
+}
+
+RenderQueue::Packet RenderQueue::makePacket(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth,
+	DrawFunction draw, const void* object, unsigned int argument) {
+
+	Packet packet;
+	packet.key = MakeKey(pass, program, material, vao, depth);
+	packet.vao = vao;
+	packet.draw = draw;
+	packet.object = object;
+	packet.argument = argument;
+	return packet;
+}
+
+void RenderQueue::Submit(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth,
+	DrawFunction draw, const void* object, unsigned int argument) {
+
+	packets.push_back(makePacket(pass, program, material, vao, depth, draw, object, argument));
+	sorted = false;
+}
+
+void RenderQueue::Append(const CommandBuffer& commands) {
+	if (commands.packets.empty())
+		return;
+	packets.insert(packets.end(), commands.packets.begin(), commands.packets.end());
+	sorted = false;
+}
+
+void RenderQueue::Sort() {
+	size_t count = packets.size();
+	keys.resize(count);
+	keysScratch.resize(count);
+	order.resize(count);
+	orderScratch.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		keys[i] = packets[i].key;
+		order[i] = uint32_t(i);
+	}
+	if (count > 1)
+		geometry::radixSort(keys.data(), order.data(), count, keysScratch.data(), orderScratch.data());
+	sorted = true;
+}
+
+void RenderQueue::Execute() {
+	if (!sorted)
+		Sort();
+
+	unsigned int pass = kUnknown, program = kUnknown, material = kUnknown, vao = kUnknown;
+	stateChanges = 0;
+	for (uint32_t index : order) {
+		const Packet& packet = packets[index];
+
+		unsigned int packetPass = field(packet.key, kPassShift, kPassBits);
+		if (packetPass != pass) {
+			pass = packetPass;
+			if (passSetups[pass])
+				passSetups[pass]();
+		}
+
+		unsigned int packetProgram = field(packet.key, kProgramShift, kProgramBits);
+		if (packetProgram != program && packetProgram < programs.size() && programs[packetProgram].name != 0) {
+			glUseProgram(programs[packetProgram].name);
+			if (programs[packetProgram].setup)
+				programs[packetProgram].setup();
+			stateChanges++;
+			// material setups may set uniforms of the program
+			material = kUnknown;
+		}
+		program = packetProgram;
+
+		unsigned int packetMaterial = field(packet.key, kMaterialShift, kMaterialBits);
+		if (packetMaterial != material && packetMaterial < materials.size() && materials[packetMaterial]) {
+			materials[packetMaterial]();
+			stateChanges++;
+		}
+		material = packetMaterial;
+
+		if (packet.vao != vao && packet.vao != 0) {
+			glBindVertexArray(packet.vao);
+			stateChanges++;
+		}
+		vao = packet.vao;
+
+		packet.draw(packet.object, packet.argument);
+
+		// whatever the draw bound itself is unknown now
+		if (packetProgram == 0)
+			program = kUnknown;
+		if (packetMaterial == 0)
+			material = kUnknown;
+		if (packet.vao == 0)
+			vao = kUnknown;
+	}
+}
+
+void RenderQueue::Clear() {
+	packets.clear();
+	order.clear();
+	sorted = true;
+}
+
+void geometry::radixSort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keysScratch, uint32_t* valuesScratch) {
+
+	// histograms of all eight bytes in one pass over the keys
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t key = keys[i];
+		for (int digit = 0; digit < 8; ++digit)
+			histograms[digit][(key >> (digit * 8)) & 0xff]++;
+	}
+
+	uint64_t* sourceKeys = keys;
+	uint32_t* sourceValues = values;
+	uint64_t* targetKeys = keysScratch;
+	uint32_t* targetValues = valuesScratch;
+	for (int digit = 0; digit < 8; ++digit) {
+		size_t* histogram = histograms[digit];
+		// a byte every key shares doesn't reorder anything
+		if (histogram[(sourceKeys[0] >> (digit * 8)) & 0xff] == count)
+			continue;
+
+		size_t offsets[256];
+		size_t sum = 0;
+		for (int bucket = 0; bucket < 256; ++bucket) {
+			offsets[bucket] = sum;
+			sum += histogram[bucket];
+		}
+		for (size_t i = 0; i < count; ++i) {
+			size_t target = offsets[(sourceKeys[i] >> (digit * 8)) & 0xff]++;
+			targetKeys[target] = sourceKeys[i];
+			targetValues[target] = sourceValues[i];
+		}
+		std::swap(sourceKeys, targetKeys);
+		std::swap(sourceValues, targetValues);
+	}
+
+	// an odd number of passes leaves the result in the scratch arrays
+	if (sourceKeys != keys) {
+		memcpy(keys, sourceKeys, count * sizeof(uint64_t));
+		memcpy(values, sourceValues, count * sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Draws of a frame collected as packets with a 64-bit sort key, sorted once and executed with the GL state
+// changes between neighbouring packets only. key layout, most significant first:
+//   pass 4 bits | program 12 bits | material 16 bits | VAO 12 bits | depth 20 bits
+// so a frame runs pass by pass, and within a pass every program and material is set up once.
+// programs and materials are registered up front with the setup that binds them (uniforms, textures).
+// a packet with program, material or VAO 0 manages that state itself, the queue forgets what was bound after it.
+// draws can also be recorded on other threads into CommandBuffers, which the GL thread Appends before sorting.
+class RenderQueue {
+public:
+	typedef void (*DrawFunction)(const void* object, unsigned int argument);
+
+private:
+	struct Packet {
+		uint64_t key;
+		unsigned int vao;
+		DrawFunction draw;
+		const void* object;
+		unsigned int argument;
+	};
+
+	static Packet makePacket(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth,
+		DrawFunction draw, const void* object, unsigned int argument);
+
+public:
+	// packets recorded away from the GL thread. Submit only fills plain structs, it makes no GL call and touches
+	// nothing of the queue, so every worker records into its own buffer without locking
+	class CommandBuffer {
+	public:
+		// same as RenderQueue::Submit, the ids are the ones the queue handed out
+		void Submit(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth,
+			DrawFunction draw, const void* object, unsigned int argument = 0) {
+			packets.push_back(makePacket(pass, program, material, vao, depth, draw, object, argument));
+		}
+		void Clear() { packets.clear(); }
+		size_t GetPacketCount() const { return packets.size(); }
+
+	private:
+		friend class RenderQueue;
+		std::vector<Packet> packets;
+	};
+
+	enum Pass {
+		kPassOpaque = 0,
+		kPassSurface = 1,
+		kPassTransparent = 2,
+		kPassCount = 16
+	};
+
+	RenderQueue();
+
+	// registers a GL program, setup runs after it is made current (per-frame uniforms). returns its queue id
+	unsigned int AddProgram(unsigned int program, std::function<void()> setup = std::function<void()>());
+	// registers a material, bind runs when a packet with it follows one with another material. returns its queue id
+	unsigned int AddMaterial(std::function<void()> bind);
+	// runs before the first packet of the pass
+	void SetPassSetup(unsigned int pass, std::function<void()> setup);
+
+	// depth is the view distance over the far plane, 0..1. translucent passes may invert it to sort back to front
+	static uint64_t MakeKey(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth);
+
+	// queues a draw: draw(object, argument) runs with the packet's program, material and VAO bound.
+	// object has to stay alive until Execute
+	void Submit(unsigned int pass, unsigned int program, unsigned int material, unsigned int vao, float depth,
+		DrawFunction draw, const void* object, unsigned int argument = 0);
+
+	// adds the packets of a command buffer, which is left as it is
+	void Append(const CommandBuffer& commands);
+
+	void Sort();
+	void Execute();
+	void Clear();
+
+	size_t GetPacketCount() const { return packets.size(); }
+	// GL state changes of the last Execute
+	unsigned int GetStateChanges() const { return stateChanges; }
+
+private:
+	struct Program {
+		unsigned int name;
+		std::function<void()> setup;
+	};
+
+	std::vector<Packet> packets;
+	std::vector<uint32_t> order;
+	// radix sort scratch
+	std::vector<uint64_t> keys, keysScratch;
+	std::vector<uint32_t> orderScratch;
+	// index 0 is the "managed by the draw" entry
+	std::vector<Program> programs;
+	std::vector<std::function<void()>> materials;
+	std::function<void()> passSetups[kPassCount];
+	bool sorted;
+	unsigned int stateChanges;
+};
+
+namespace geometry {
+
+	// sorts keys ascending and applies the same permutation to values. LSD radix sort on bytes, digits that are the
+	// same for every key are skipped. keysScratch and valuesScratch need count entries
+	void radixSort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keysScratch, uint32_t* valuesScratch);
+}
@@ -0,0 +1,445 @@
+#include "SceneBvh.h"
+#include <algorithm>
+#include <cfloat>
+#include "glm/common.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENEBVH_SSE
+#endif
+
+namespace {
+
+	const int kBinCount = 16;
+
+	float surfaceArea(const glm::vec3& minimum, const glm::vec3& maximum) {
+		glm::vec3 size = maximum - minimum;
+		if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+			return 0.0f;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	struct Bin {
+		glm::vec3 minimum, maximum;
+		int count;
+	};
+
+	void resetBin(Bin& bin) {
+		bin.minimum = glm::vec3(FLT_MAX);
+		bin.maximum = glm::vec3(-FLT_MAX);
+		bin.count = 0;
+	}
+
+	// bit i is set when child slot i of the node intersects the frustum
+	template <typename Node>
+	int frustumMask(const Node& node, const Frustum& frustum) {
+#if defined(SCENEBVH_SSE)
+		__m128 half = _mm_set1_ps(0.5f);
+		__m128 minX = _mm_loadu_ps(node.minX), minY = _mm_loadu_ps(node.minY), minZ = _mm_loadu_ps(node.minZ);
+		__m128 maxX = _mm_loadu_ps(node.maxX), maxY = _mm_loadu_ps(node.maxY), maxZ = _mm_loadu_ps(node.maxZ);
+		__m128 cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half), ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+		__m128 cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half), ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+		__m128 cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for (const glm::vec4& plane : frustum.planes) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(plane.y)))),
+				_mm_mul_ps(ez, _mm_set1_ps(fabsf(plane.z))));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+		}
+		return _mm_movemask_ps(inside);
+#else
+		int mask = 0;
+		for (int slot = 0; slot < 4; ++slot) {
+			glm::vec3 center(node.minX[slot] + node.maxX[slot], node.minY[slot] + node.maxY[slot], node.minZ[slot] + node.maxZ[slot]);
+			glm::vec3 extent(node.maxX[slot] - node.minX[slot], node.maxY[slot] - node.minY[slot], node.maxZ[slot] - node.minZ[slot]);
+			center *= 0.5f;
+			extent *= 0.5f;
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				float reach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+				inside = inside && distance + reach >= 0.0f;
+			}
+			mask |= inside ? 1 << slot : 0;
+		}
+		return mask;
+#endif
+	}
+
+	// bit i is set when child slot i is at most radius away from center
+	template <typename Node>
+	int sphereMask(const Node& node, const glm::vec3& center, float radius) {
+#if defined(SCENEBVH_SSE)
+		__m128 zero = _mm_setzero_ps();
+		__m128 px = _mm_set1_ps(center.x), py = _mm_set1_ps(center.y), pz = _mm_set1_ps(center.z);
+		// distance along every axis from the center to the box, 0 inside its slab
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), px), _mm_sub_ps(px, _mm_loadu_ps(node.maxX))), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), py), _mm_sub_ps(py, _mm_loadu_ps(node.maxY))), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), pz), _mm_sub_ps(pz, _mm_loadu_ps(node.maxZ))), zero);
+		__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_movemask_ps(_mm_cmple_ps(squared, _mm_set1_ps(radius * radius)));
+#else
+		int mask = 0;
+		for (int slot = 0; slot < 4; ++slot) {
+			float dx = std::max(std::max(node.minX[slot] - center.x, center.x - node.maxX[slot]), 0.0f);
+			float dy = std::max(std::max(node.minY[slot] - center.y, center.y - node.maxY[slot]), 0.0f);
+			float dz = std::max(std::max(node.minZ[slot] - center.z, center.z - node.maxZ[slot]), 0.0f);
+			mask |= dx * dx + dy * dy + dz * dz <= radius * radius ? 1 << slot : 0;
+		}
+		return mask;
+#endif
+	}
+
+	// slab test of the four child boxes, bit i is set when the ray enters slot i within [0, maxDistance], at entry[i]
+	template <typename Node>
+	int rayMask(const Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float* entry) {
+#if defined(SCENEBVH_SSE)
+		__m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		__m128 ix = _mm_set1_ps(inverseDirection.x), iy = _mm_set1_ps(inverseDirection.y), iz = _mm_set1_ps(inverseDirection.z);
+		__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), ix);
+		__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), iy);
+		__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), iz);
+		__m128 entering = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+		__m128 leaving = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance)));
+		_mm_storeu_ps(entry, entering);
+		return _mm_movemask_ps(_mm_cmple_ps(entering, leaving));
+#else
+		int mask = 0;
+		for (int slot = 0; slot < 4; ++slot) {
+			float x0 = (node.minX[slot] - origin.x) * inverseDirection.x, x1 = (node.maxX[slot] - origin.x) * inverseDirection.x;
+			float y0 = (node.minY[slot] - origin.y) * inverseDirection.y, y1 = (node.maxY[slot] - origin.y) * inverseDirection.y;
+			float z0 = (node.minZ[slot] - origin.z) * inverseDirection.z, z1 = (node.maxZ[slot] - origin.z) * inverseDirection.z;
+			float entering = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+			float leaving = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), maxDistance));
+			entry[slot] = entering;
+			mask |= entering <= leaving ? 1 << slot : 0;
+		}
+		return mask;
+#endif
+	}
+}
+
+SceneBvh::SceneBvh() : needsBuild(false), builtArea(0.0f), currentArea(0.0f) {
+}
+
+int SceneBvh::AddObject(const glm::vec3& minimum, const glm::vec3& maximum) {
+	minimums.push_back(minimum);
+	maximums.push_back(maximum);
+	objectNodes.push_back(-1);
+	objectSlots.push_back(0);
+	isMoved.push_back(0);
+	needsBuild = true;
+	return static_cast<int>(minimums.size() - 1);
+}
+
+void SceneBvh::SetBounds(int object, const glm::vec3& minimum, const glm::vec3& maximum) {
+	minimums[object] = minimum;
+	maximums[object] = maximum;
+	if (!isMoved[object]) {
+		isMoved[object] = 1;
+		moved.push_back(object);
+	}
+}
+
+void SceneBvh::Build() {
+
+	nodes.clear();
+	currentArea = 0.0f;
+	for (int object : moved)
+		isMoved[object] = 0;
+	moved.clear();
+	needsBuild = false;
+
+	int count = static_cast<int>(minimums.size());
+	order.resize(count);
+	centroids.resize(count);
+	for (int i = 0; i < count; ++i) {
+		order[i] = i;
+		centroids[i] = (minimums[i] + maximums[i]) * 0.5f;
+	}
+	if (count > 0)
+		buildNode(0, count, -1, 0);
+	builtArea = currentArea;
+}
+
+void SceneBvh::Update(float rebuildThreshold) {
+
+	if (needsBuild) {
+		Build();
+		return;
+	}
+	for (int object : moved) {
+		refit(object);
+		isMoved[object] = 0;
+	}
+	moved.clear();
+	if (currentArea > builtArea * rebuildThreshold)
+		Build();
+}
+
+// makes a node for the objects order[begin, end): the range is split with the SAH until there are four parts or
+// nothing left to split, parts of one object become leaf slots, larger ones child nodes
+int SceneBvh::buildNode(int begin, int end, int parent, int parentSlot) {
+
+	int index = static_cast<int>(nodes.size());
+	nodes.push_back(Node());
+	Node& created = nodes.back();
+	for (int slot = 0; slot < 4; ++slot) {
+		created.minX[slot] = created.minY[slot] = created.minZ[slot] = FLT_MAX;
+		created.maxX[slot] = created.maxY[slot] = created.maxZ[slot] = -FLT_MAX;
+		created.children[slot] = kEmptySlot;
+	}
+	created.parent = parent;
+	created.parentSlot = parentSlot;
+
+	int ranges[4][2] = { { begin, end } };
+	int rangeCount = 1;
+	while (rangeCount < 4) {
+		// split the part with the largest box next
+		int widest = -1;
+		float widestArea = -1.0f;
+		for (int i = 0; i < rangeCount; ++i) {
+			if (ranges[i][1] - ranges[i][0] < 2)
+				continue;
+			glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+			for (int j = ranges[i][0]; j < ranges[i][1]; ++j) {
+				minimum = glm::min(minimum, minimums[order[j]]);
+				maximum = glm::max(maximum, maximums[order[j]]);
+			}
+			float area = surfaceArea(minimum, maximum);
+			if (area > widestArea) {
+				widestArea = area;
+				widest = i;
+			}
+		}
+		if (widest < 0)
+			break;
+		int middle = splitRange(ranges[widest][0], ranges[widest][1]);
+		ranges[rangeCount][0] = middle;
+		ranges[rangeCount][1] = ranges[widest][1];
+		ranges[widest][1] = middle;
+		rangeCount++;
+	}
+
+	for (int slot = 0; slot < rangeCount; ++slot) {
+		int first = ranges[slot][0], last = ranges[slot][1];
+		if (last - first == 1) {
+			int object = order[first];
+			nodes[index].children[slot] = ~object;
+			objectNodes[object] = index;
+			objectSlots[object] = slot;
+			setSlot(nodes[index], slot, minimums[object], maximums[object]);
+			continue;
+		}
+		// push_back in the recursion may move the nodes, only indices are kept across it
+		int child = buildNode(first, last, index, slot);
+		nodes[index].children[slot] = child;
+		const Node& built = nodes[child];
+		glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+		for (int i = 0; i < 4; ++i) {
+			minimum = glm::min(minimum, glm::vec3(built.minX[i], built.minY[i], built.minZ[i]));
+			maximum = glm::max(maximum, glm::vec3(built.maxX[i], built.maxY[i], built.maxZ[i]));
+		}
+		setSlot(nodes[index], slot, minimum, maximum);
+	}
+	return index;
+}
+
+// partitions order[begin, end) into two non-empty halves with the cheapest binned SAH split over all three axes,
+// returns where the second half starts
+int SceneBvh::splitRange(int begin, int end) {
+
+	glm::vec3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+	for (int i = begin; i < end; ++i) {
+		centerMin = glm::min(centerMin, centroids[order[i]]);
+		centerMax = glm::max(centerMax, centroids[order[i]]);
+	}
+
+	int bestAxis = -1, bestBin = 0;
+	float bestCost = FLT_MAX;
+	Bin bins[kBinCount];
+	float rightArea[kBinCount];
+	int rightCount[kBinCount];
+	for (int axis = 0; axis < 3; ++axis) {
+		float extent = centerMax[axis] - centerMin[axis];
+		if (extent <= 0.0f)
+			continue;
+		float scale = kBinCount / extent;
+		for (Bin& bin : bins)
+			resetBin(bin);
+		for (int i = begin; i < end; ++i) {
+			int object = order[i];
+			int bin = std::min(static_cast<int>((centroids[object][axis] - centerMin[axis]) * scale), kBinCount - 1);
+			bins[bin].minimum = glm::min(bins[bin].minimum, minimums[object]);
+			bins[bin].maximum = glm::max(bins[bin].maximum, maximums[object]);
+			bins[bin].count++;
+		}
+
+		// sweep from the right for the boxes of bins i.. and from the left for the split cost before bin i
+		Bin right;
+		resetBin(right);
+		for (int i = kBinCount - 1; i > 0; --i) {
+			right.minimum = glm::min(right.minimum, bins[i].minimum);
+			right.maximum = glm::max(right.maximum, bins[i].maximum);
+			right.count += bins[i].count;
+			rightArea[i] = surfaceArea(right.minimum, right.maximum);
+			rightCount[i] = right.count;
+		}
+		Bin left;
+		resetBin(left);
+		for (int i = 1; i < kBinCount; ++i) {
+			left.minimum = glm::min(left.minimum, bins[i - 1].minimum);
+			left.maximum = glm::max(left.maximum, bins[i - 1].maximum);
+			left.count += bins[i - 1].count;
+			if (left.count == 0 || rightCount[i] == 0)
+				continue;
+			float cost = surfaceArea(left.minimum, left.maximum) * left.count + rightArea[i] * rightCount[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = i;
+			}
+		}
+	}
+
+	int middle = begin + (end - begin) / 2;
+	if (bestAxis >= 0) {
+		float scale = kBinCount / (centerMax[bestAxis] - centerMin[bestAxis]);
+		const std::vector<glm::vec3>& centers = centroids;
+		glm::vec3 origin = centerMin;
+		int axis = bestAxis, bin = bestBin;
+		int* split = std::partition(order.data() + begin, order.data() + end, [&](int object) {
+			return std::min(static_cast<int>((centers[object][axis] - origin[axis]) * scale), kBinCount - 1) < bin;
+		});
+		middle = static_cast<int>(split - order.data());
+	}
+	// all centroids in one spot, any split is as good as the other
+	if (middle == begin || middle == end)
+		middle = begin + (end - begin) / 2;
+	return middle;
+}
+
+void SceneBvh::setSlot(Node& node, int slot, const glm::vec3& minimum, const glm::vec3& maximum) {
+	glm::vec3 oldMinimum(node.minX[slot], node.minY[slot], node.minZ[slot]);
+	glm::vec3 oldMaximum(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+	currentArea += surfaceArea(minimum, maximum) - surfaceArea(oldMinimum, oldMaximum);
+	node.minX[slot] = minimum.x;
+	node.minY[slot] = minimum.y;
+	node.minZ[slot] = minimum.z;
+	node.maxX[slot] = maximum.x;
+	node.maxY[slot] = maximum.y;
+	node.maxZ[slot] = maximum.z;
+}
+
+// stores the object's box in its leaf slot and grows or shrinks the boxes above it, up to the first one that stays the same
+void SceneBvh::refit(int object) {
+
+	int index = objectNodes[object];
+	if (index < 0)
+		return;
+	setSlot(nodes[index], objectSlots[object], minimums[object], maximums[object]);
+	while (nodes[index].parent >= 0) {
+		const Node& node = nodes[index];
+		glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+		for (int i = 0; i < 4; ++i) {
+			minimum = glm::min(minimum, glm::vec3(node.minX[i], node.minY[i], node.minZ[i]));
+			maximum = glm::max(maximum, glm::vec3(node.maxX[i], node.maxY[i], node.maxZ[i]));
+		}
+		Node& parent = nodes[node.parent];
+		int slot = node.parentSlot;
+		if (parent.minX[slot] == minimum.x && parent.minY[slot] == minimum.y && parent.minZ[slot] == minimum.z &&
+			parent.maxX[slot] == maximum.x && parent.maxY[slot] == maximum.y && parent.maxZ[slot] == maximum.z)
+			break;
+		setSlot(parent, slot, minimum, maximum);
+		index = node.parent;
+	}
+}
+
+size_t SceneBvh::QueryFrustum(const Frustum& frustum, std::vector<int>& result) const {
+
+	size_t found = result.size();
+	if (nodes.empty())
+		return 0;
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		int mask = frustumMask(node, frustum);
+		for (int slot = 0; slot < 4; ++slot) {
+			if (!(mask & (1 << slot)))
+				continue;
+			int child = node.children[slot];
+			if (child >= 0)
+				stack.push_back(child);
+			else
+				result.push_back(~child);
+		}
+	}
+	return result.size() - found;
+}
+
+size_t SceneBvh::QueryRadius(const glm::vec3& center, float radius, std::vector<int>& result) const {
+
+	size_t found = result.size();
+	if (nodes.empty())
+		return 0;
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		int mask = sphereMask(node, center, radius);
+		for (int slot = 0; slot < 4; ++slot) {
+			if (!(mask & (1 << slot)))
+				continue;
+			int child = node.children[slot];
+			if (child >= 0)
+				stack.push_back(child);
+			else
+				result.push_back(~child);
+		}
+	}
+	return result.size() - found;
+}
+
+int SceneBvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance) const {
+
+	int hit = kNoObject;
+	float nearest = maxDistance;
+	if (nodes.empty())
+		return hit;
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	// nodes with the distance the ray enters them, children are pushed far to near so the nearest is visited first
+	std::vector<std::pair<int, float> > stack(1, std::make_pair(0, 0.0f));
+	while (!stack.empty()) {
+		std::pair<int, float> top = stack.back();
+		stack.pop_back();
+		if (top.second > nearest)
+			continue;
+		const Node& node = nodes[top.first];
+		float entry[4];
+		int mask = rayMask(node, origin, inverseDirection, nearest, entry);
+
+		int slots[4], slotCount = 0;
+		for (int slot = 0; slot < 4; ++slot) {
+			// the inverted box of an empty slot passes the slab test for rays along the axes
+			if ((mask & (1 << slot)) && node.children[slot] != kEmptySlot)
+				slots[slotCount++] = slot;
+		}
+		std::sort(slots, slots + slotCount, [&](int a, int b) { return entry[a] > entry[b]; });
+		for (int i = 0; i < slotCount; ++i) {
+			int child = node.children[slots[i]];
+			if (child >= 0)
+				stack.push_back(std::make_pair(child, entry[slots[i]]));
+			else if (entry[slots[i]] <= nearest) {
+				nearest = entry[slots[i]];
+				hit = ~child;
+			}
+		}
+	}
+	if (distance && hit != kNoObject)
+		*distance = nearest;
+	return hit;
+}
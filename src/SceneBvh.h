@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <climits>
+#include <vector>
+#include "glm/ext/vector_float3.hpp"
+#include "Frustum.h"
+
+// Bounding volume hierarchy over the world space boxes of scene objects. every node has four children whose boxes
+// are stored per component, so a query tests all four with one SSE step. Build creates the tree with the binned
+// surface area heuristic, SetBounds of a moving object only refits the boxes on its path to the root at the next
+// Update, which rebuilds instead when objects were added or the refitted boxes have become too loose.
+class SceneBvh {
+public:
+	static const int kNoObject = -1;
+
+	SceneBvh();
+
+	// adds an object with its box and returns its id, queries find it after the next Update
+	int AddObject(const glm::vec3& minimum, const glm::vec3& maximum);
+	void SetBounds(int object, const glm::vec3& minimum, const glm::vec3& maximum);
+	size_t GetObjectCount() const { return minimums.size(); }
+	size_t GetNodeCount() const { return nodes.size(); }
+
+	void Build();
+	// refits the boxes of the objects moved since the last call, or rebuilds after AddObject and when the summed
+	// surface area of the node boxes grew to more than rebuildThreshold times the one of the last build
+	void Update(float rebuildThreshold = 2.0f);
+
+	// append the ids of the objects whose box intersects the frustum or the sphere to result, return how many
+	size_t QueryFrustum(const Frustum& frustum, std::vector<int>& result) const;
+	size_t QueryRadius(const glm::vec3& center, float radius, std::vector<int>& result) const;
+	// the object whose box the ray enters first within maxDistance, kNoObject if it misses all of them.
+	// distance is in units of direction, which doesn't have to be normalized
+	int Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = nullptr) const;
+
+private:
+	static const int kEmptySlot = INT_MIN;
+
+	struct Node {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		// >= 0 an inner node, < 0 the object ~child, kEmptySlot for unused slots (their box is empty)
+		int children[4];
+		int parent;
+		int parentSlot;
+	};
+
+	std::vector<glm::vec3> minimums;
+	std::vector<glm::vec3> maximums;
+	// node and slot every object is stored in
+	std::vector<int> objectNodes;
+	std::vector<int> objectSlots;
+	std::vector<Node> nodes;
+	// objects moved since the last Update
+	std::vector<int> moved;
+	std::vector<unsigned char> isMoved;
+	bool needsBuild;
+	float builtArea;
+	float currentArea;
+	// object order of Build, reused
+	std::vector<int> order;
+	std::vector<glm::vec3> centroids;
+
+	int buildNode(int begin, int end, int parent, int parentSlot);
+	int splitRange(int begin, int end);
+	void setSlot(Node& node, int slot, const glm::vec3& minimum, const glm::vec3& maximum);
+	void refit(int object);
+};
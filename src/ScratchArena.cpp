@@ -0,0 +1,54 @@
+#include "ScratchArena.h"
+#include <algorithm>
+#include <cstdint>
+
+ScratchArena::ScratchArena(size_t blockSize)
+	: blockSize(std::max<size_t>(blockSize, 64)), used(0), allocatedBytes(0), peakBytes(0) {
+}
+
+ScratchArena::~ScratchArena() {
+	for (Block& block : blocks)
+		delete[] block.data;
+}
+
+void ScratchArena::Reset() {
+	// merge the blocks into one that fits all of them, the next meshes are usually of similar size
+	if (blocks.size() > 1) {
+		size_t total = 0;
+		for (Block& block : blocks) {
+			total += block.size;
+			delete[] block.data;
+		}
+		blocks.clear();
+		addBlock(total);
+	}
+	used = 0;
+	allocatedBytes = 0;
+}
+
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+
+	if (!blocks.empty()) {
+		Block& block = blocks.back();
+		uintptr_t start = reinterpret_cast<uintptr_t>(block.data) + used;
+		size_t padding = (alignment - start % alignment) % alignment;
+		if (used + padding + bytes <= block.size) {
+			used += padding + bytes;
+			allocatedBytes += padding + bytes;
+			peakBytes = std::max(peakBytes, allocatedBytes);
+			return block.data + used - bytes;
+		}
+	}
+
+	// operator new[] is aligned for every fundamental type, so a fresh block needs no padding
+	addBlock(std::max(blockSize, bytes));
+	used = bytes;
+	allocatedBytes += bytes;
+	peakBytes = std::max(peakBytes, allocatedBytes);
+	return blocks.back().data;
+}
+
+void ScratchArena::addBlock(size_t size) {
+	Block block = { new char[size], size };
+	blocks.push_back(block);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for the short lived buffers of an import (remap tables, reordered index copies).
+// Allocations are bumped out of large blocks and released all at once by Reset, which keeps a single
+// block big enough for everything handed out so far, so the following meshes don't touch the heap.
+class ScratchArena {
+public:
+	explicit ScratchArena(size_t blockSize = 1 << 20);
+	~ScratchArena();
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	// uninitialized storage for count objects, valid until the next Reset
+	template<typename T>
+	T* Allocate(size_t count) {
+		static_assert(std::is_trivially_copyable<T>::value, "ScratchArena never runs constructors or destructors");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void Reset();
+
+	// most bytes that were in use between two resets
+	size_t GetPeakBytes() const { return peakBytes; }
+
+private:
+	struct Block {
+		char* data;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	size_t blockSize;
+	size_t used;
+	size_t allocatedBytes;
+	size_t peakBytes;
+
+	void* allocate(size_t bytes, size_t alignment);
+	void addBlock(size_t size);
+};
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <iostream>
 #include <GL/glew.h>
+#include "AssetFile.h"
 #include "glm/ext/vector_float3.hpp"
 #include "glm/ext/vector_float2.hpp"
 #include "glm/ext/vector_float4.hpp"
@@ -16,7 +17,7 @@
 namespace util {
 
     struct shaderFilePathBundle {
-        const char* vertex, * geometry, * tcs, * tes, * fragment;
+        const char* vertex, * geometry, * tcs, * tes, * fragment, * compute;
     };
 
     unsigned int load_shader(const shaderFilePathBundle& filepaths);
@@ -32,33 +33,13 @@ public:
     Shader(const char* vertexPath, const char* fragmentPath)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+        // (from the mounted pack archive when there is one, see AssetFile)
+        AssetFile vShaderFile(vertexPath);
+        AssetFile fShaderFile(fragmentPath);
+        if (!vShaderFile.IsOpen() || !fShaderFile.IsOpen())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << (vShaderFile.IsOpen() ? fragmentPath : vertexPath) << std::endl;
+        std::string vertexCode = vShaderFile.ToString();
+        std::string fragmentCode = fShaderFile.ToString();
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -207,6 +188,10 @@ unsigned int util::load_shader(const shaderFilePathBundle& filepaths) {
         modules.push_back(load_shader_module(filepaths.fragment, GL_FRAGMENT_SHADER));
     }
 
+    if (filepaths.compute) {
+        modules.push_back(load_shader_module(filepaths.compute, GL_COMPUTE_SHADER));
+    }
+
     unsigned int shader = glCreateProgram();
     for (unsigned int shaderModule : modules) {
         glAttachShader(shader, shaderModule);
@@ -231,18 +216,12 @@ unsigned int util::load_shader(const shaderFilePathBundle& filepaths) {
 
 unsigned int util::load_shader_module(const char* filepath, unsigned int type) {
 
-    std::ifstream fileReader;
-    std::stringstream bufferedLines;
-    std::string line;
-
-    fileReader.open(filepath);
-    while (std::getline(fileReader, line)) {
-        bufferedLines << line << '\n';
+    AssetFile file(filepath);
+    if (!file.IsOpen()) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << filepath << '\n';
     }
-    std::string shaderSource = bufferedLines.str();
+    std::string shaderSource = file.ToString();
     const char* shaderSrc = shaderSource.c_str();
-    bufferedLines.str("");
-    fileReader.close();
 
     unsigned int shaderModule = glCreateShader(type);
     glShaderSource(shaderModule, 1, &shaderSrc, NULL);
@@ -0,0 +1,154 @@
+#include "Skinning.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "UploadRing.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SKINNING_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SKINNING_SSE
+#endif
+
+BonePalette::BonePalette(size_t capacity) {
+	matrices.reserve(capacity);
+}
+
+int BonePalette::Add(const glm::mat4* palette, size_t count) {
+	int offset = int(matrices.size());
+	matrices.insert(matrices.end(), palette, palette + count);
+	return offset;
+}
+
+void BonePalette::Upload(UploadRing& ring) {
+	if (matrices.empty())
+		return;
+	UploadRing::Allocation allocation = ring.AllocateStorage(matrices.size() * sizeof(glm::mat4));
+	if (!allocation.data)
+		return;
+	memcpy(allocation.data, matrices.data(), allocation.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kBinding, allocation.buffer, allocation.offset, allocation.size);
+}
+
+namespace {
+
+	void normalize(float* v) {
+		float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.0f) {
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+#if defined(SKINNING_AVX)
+	// a matrix as two registers, columns 0|1 and 2|3
+	struct Blend {
+		__m256 low, high;
+	};
+
+	inline __m256 broadcastPair(float a, float b) {
+		return _mm256_setr_ps(a, a, a, a, b, b, b, b);
+	}
+
+	// c0 * x + c1 * y + c2 * z + c3 * w
+	inline void transform(const Blend& m, const float* v, float w, float* out) {
+		__m256 sum = _mm256_add_ps(_mm256_mul_ps(m.low, broadcastPair(v[0], v[1])), _mm256_mul_ps(m.high, broadcastPair(v[2], w)));
+		__m128 result = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		float stored[4];
+		_mm_storeu_ps(stored, result);
+		out[0] = stored[0];
+		out[1] = stored[1];
+		out[2] = stored[2];
+	}
+#elif defined(SKINNING_SSE)
+	struct Blend {
+		__m128 columns[4];
+	};
+
+	inline void transform(const Blend& m, const float* v, float w, float* out) {
+		__m128 sum = _mm_mul_ps(m.columns[0], _mm_set1_ps(v[0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(m.columns[1], _mm_set1_ps(v[1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(m.columns[2], _mm_set1_ps(v[2])));
+		if (w != 0.0f)
+			sum = _mm_add_ps(sum, _mm_mul_ps(m.columns[3], _mm_set1_ps(w)));
+		float stored[4];
+		_mm_storeu_ps(stored, sum);
+		out[0] = stored[0];
+		out[1] = stored[1];
+		out[2] = stored[2];
+	}
+#else
+	struct Blend {
+		glm::mat4 matrix;
+	};
+
+	inline void transform(const Blend& m, const float* v, float w, float* out) {
+		glm::vec4 result = m.matrix * glm::vec4(v[0], v[1], v[2], w);
+		out[0] = result.x;
+		out[1] = result.y;
+		out[2] = result.z;
+	}
+#endif
+
+	// weighted sum of the palette matrices of a vertex, false when it has no usable weight
+	inline bool blend(Blend& m, const Vertex& vertex, const glm::mat4* palette, size_t boneCount) {
+		bool weighted = false;
+#if defined(SKINNING_AVX)
+		m.low = _mm256_setzero_ps();
+		m.high = _mm256_setzero_ps();
+#elif defined(SKINNING_SSE)
+		for (int c = 0; c < 4; ++c)
+			m.columns[c] = _mm_setzero_ps();
+#else
+		m.matrix = glm::mat4(0.0f);
+#endif
+		for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+			float weight = vertex.m_Weights[i];
+			int bone = vertex.m_BoneIDs[i];
+			if (weight == 0.0f || bone < 0 || size_t(bone) >= boneCount)
+				continue;
+			const float* source = &palette[bone][0][0];
+#if defined(SKINNING_AVX)
+			__m256 w = _mm256_set1_ps(weight);
+			m.low = _mm256_add_ps(m.low, _mm256_mul_ps(_mm256_loadu_ps(source), w));
+			m.high = _mm256_add_ps(m.high, _mm256_mul_ps(_mm256_loadu_ps(source + 8), w));
+#elif defined(SKINNING_SSE)
+			__m128 w = _mm_set1_ps(weight);
+			for (int c = 0; c < 4; ++c)
+				m.columns[c] = _mm_add_ps(m.columns[c], _mm_mul_ps(_mm_loadu_ps(source + c * 4), w));
+#else
+			m.matrix += palette[bone] * weight;
+#endif
+			weighted = true;
+		}
+		return weighted;
+	}
+}
+
+void geometry::skinVertices(Vertex* destination, const Vertex* vertices, size_t count, const glm::mat4* palette, size_t boneCount) {
+
+	for (size_t i = 0; i < count; ++i) {
+		const Vertex& vertex = vertices[i];
+		Blend m;
+		if (!blend(m, vertex, palette, boneCount)) {
+			if (destination != vertices)
+				destination[i] = vertex;
+			continue;
+		}
+
+		// the source may be the destination, everything is read before it is written
+		Vertex skinned = vertex;
+		transform(m, &vertex.Position.x, 1.0f, &skinned.Position.x);
+		transform(m, &vertex.Normal.x, 0.0f, &skinned.Normal.x);
+		transform(m, &vertex.Tangent.x, 0.0f, &skinned.Tangent.x);
+		transform(m, &vertex.Bitangent.x, 0.0f, &skinned.Bitangent.x);
+		normalize(&skinned.Normal.x);
+		normalize(&skinned.Tangent.x);
+		normalize(&skinned.Bitangent.x);
+		destination[i] = skinned;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "Vertex.h"
+
+class UploadRing;
+
+// Shader storage buffer with the bone palettes of every skinned draw of a frame, read by
+// 1.model_loading_skinned.vs as bones[boneOffset + id]. palettes are collected on the CPU and uploaded together
+// into the frame's part of an UploadRing.
+class BonePalette {
+public:
+	static const unsigned int kBinding = 0;
+
+	explicit BonePalette(size_t capacity = 1024);
+
+	// queues a palette for this frame and returns the index of its first matrix, the boneOffset uniform of the draw
+	int Add(const glm::mat4* matrices, size_t count);
+	int Add(const std::vector<glm::mat4>& palette) { return Add(palette.data(), palette.size()); }
+
+	// uploads the palettes added since the last Clear and binds their range of the ring to kBinding
+	void Upload(UploadRing& ring);
+	void Clear() { matrices.clear(); }
+
+private:
+	std::vector<glm::mat4> matrices;
+};
+
+namespace geometry {
+
+	// linear blend skinning on the CPU for backends without the skinning vertex shader. position, normal, tangent and
+	// bitangent are transformed by the weighted sum of the palette matrices, everything else is copied. vertices without
+	// weights are copied unchanged, bone ids outside the palette are ignored. uses AVX when the build enables it, SSE otherwise.
+	// destination may alias vertices.
+	void skinVertices(Vertex* destination, const Vertex* vertices, size_t count, const glm::mat4* palette, size_t boneCount);
+}
@@ -0,0 +1,120 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#endif
+
+TransformHierarchy::TransformHierarchy(size_t reserve) : firstDirty(0) {
+	parents.reserve(reserve);
+	locals.reserve(reserve);
+	worlds.reserve(reserve);
+	dirty.reserve(reserve);
+}
+
+int TransformHierarchy::AddNode(int parent, const glm::mat4& local) {
+	int node = int(parents.size());
+	// a parent that doesn't exist yet would break the parent before child order Update relies on
+	if (parent >= node)
+		parent = kNoParent;
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	firstDirty = std::min(firstDirty, size_t(node));
+	return node;
+}
+
+void TransformHierarchy::SetLocal(int node, const glm::mat4& local) {
+	locals[node] = local;
+	dirty[node] = 1;
+	firstDirty = std::min(firstDirty, size_t(node));
+}
+
+size_t TransformHierarchy::Update() {
+
+	size_t count = parents.size();
+	if (firstDirty >= count) {
+		firstDirty = count;
+		return 0;
+	}
+
+	// a node is recomputed when it is dirty itself or its parent was recomputed, parents come first so one pass
+	// carries the flag down whole subtrees
+	pending.clear();
+	for (size_t i = firstDirty; i < count; ++i) {
+		int parent = parents[i];
+		if (!dirty[i] && (parent == kNoParent || !dirty[parent]))
+			continue;
+		dirty[i] = 1;
+		pending.push_back(unsigned(i));
+	}
+
+	// roots just copy their local matrix, everything else is multiplied in batches. a batch ends before the first
+	// node whose parent is still waiting in it, so the parent worlds a batch reads are always final
+	const size_t kBatch = 64;
+	const glm::mat4* parentWorlds[kBatch];
+	const glm::mat4* localMatrices[kBatch];
+	glm::mat4 results[kBatch];
+	unsigned int targets[kBatch];
+	size_t batched = 0;
+
+	auto flush = [&]() {
+		geometry::multiplyMatrices(results, parentWorlds, localMatrices, batched);
+		for (size_t j = 0; j < batched; ++j)
+			worlds[targets[j]] = results[j];
+		batched = 0;
+	};
+
+	for (size_t i = 0; i < pending.size(); ++i) {
+		unsigned int node = pending[i];
+		int parent = parents[node];
+		if (parent == kNoParent) {
+			worlds[node] = locals[node];
+			continue;
+		}
+		if (batched == kBatch || (batched > 0 && unsigned(parent) >= targets[0] &&
+			std::find(targets, targets + batched, unsigned(parent)) != targets + batched))
+			flush();
+		parentWorlds[batched] = &worlds[parent];
+		localMatrices[batched] = &locals[node];
+		targets[batched++] = node;
+	}
+	flush();
+
+	for (unsigned int node : pending)
+		dirty[node] = 0;
+	firstDirty = count;
+	return pending.size();
+}
+
+void geometry::multiplyMatrices(glm::mat4* result, const glm::mat4* const* parents, const glm::mat4* const* locals, size_t count) {
+
+	for (size_t i = 0; i < count; ++i) {
+#ifdef TRANSFORM_HIERARCHY_SSE
+		const float* a = &(*parents[i])[0][0];
+		const float* b = &(*locals[i])[0][0];
+		float* r = &result[i][0][0];
+		// every column of the result is the parent columns weighted by one column of the local matrix
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+		__m128 c[4];
+		for (int column = 0; column < 4; ++column) {
+			const float* bc = b + column * 4;
+			__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+			c[column] = sum;
+		}
+		// stored after all columns are computed, so result may be the local matrix itself
+		for (int column = 0; column < 4; ++column)
+			_mm_storeu_ps(r + column * 4, c[column]);
+#else
+		result[i] = *parents[i] * *locals[i];
+#endif
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "glm/mat4x4.hpp"
+
+// Local and world matrices of a node tree, stored as parallel arrays with every parent before its children.
+// SetLocal only marks a node dirty, Update then recomputes the world matrices of the dirty nodes and their
+// subtrees in one linear pass, so nodes that never move (and their children) cost nothing per frame.
+class TransformHierarchy {
+public:
+	static const int kNoParent = -1;
+
+	explicit TransformHierarchy(size_t reserve = 0);
+
+	// appends a node, parent has to be an existing node or kNoParent. the world matrix is valid after the next Update
+	int AddNode(int parent, const glm::mat4& local = glm::mat4(1.0f));
+	void SetLocal(int node, const glm::mat4& local);
+
+	const glm::mat4& GetLocal(int node) const { return locals[node]; }
+	const glm::mat4& GetWorld(int node) const { return worlds[node]; }
+	int GetParent(int node) const { return parents[node]; }
+	size_t GetNodeCount() const { return parents.size(); }
+
+	// recomputes the world matrices of all nodes whose local matrix or any ancestor changed, returns how many
+	size_t Update();
+
+private:
+	std::vector<int> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;
+	// nodes recomputed by the current Update, reused between frames
+	std::vector<unsigned int> pending;
+	// lowest dirty node, nothing before it needs to be looked at. equal to the node count when nothing is dirty
+	size_t firstDirty;
+};
+
+namespace geometry {
+
+	// result[i] = parents[i] * locals[i] for count matrices, column major like glm. result may alias locals but not parents
+	void multiplyMatrices(glm::mat4* result, const glm::mat4* const* parents, const glm::mat4* const* locals, size_t count);
+}
@@ -0,0 +1,116 @@
+#include "UploadRing.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+	const GLbitfield kStorageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	size_t alignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+UploadRing::UploadRing(size_t frameSize, unsigned int framesInFlight)
+	: buffer(0), mapped(nullptr), framesInFlight(std::max(framesInFlight, 1u)), region(0), used(0), frame(0),
+	fences(this->framesInFlight, nullptr) {
+
+	GLint uniform = 256, storage = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage);
+	uniformAlignment = std::max<size_t>(uniform, 16);
+	storageAlignment = std::max<size_t>(storage, 16);
+	// every region starts at an offset that suits any binding
+	this->frameSize = alignUp(std::max<size_t>(frameSize, 1), std::max<size_t>(256, std::max(uniformAlignment, storageAlignment)));
+	create();
+}
+
+UploadRing::~UploadRing() {
+	for (void* fence : fences)
+		if (fence)
+			glDeleteSync(static_cast<GLsync>(fence));
+	for (const Retired& old : retired)
+		glDeleteBuffers(1, &old.buffer);
+	// deleting a mapped buffer unmaps it
+	glDeleteBuffers(1, &buffer);
+}
+
+void UploadRing::create() {
+	// persistent mapping needs immutable storage, without it every allocation fails (NULL data) instead
+	if (!GLEW_VERSION_4_4 && !GLEW_ARB_buffer_storage) {
+		std::cout << "ERROR::UPLOAD_RING::NO_BUFFER_STORAGE needs OpenGL 4.4 or ARB_buffer_storage" << std::endl;
+		return;
+	}
+	size_t size = frameSize * framesInFlight;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, NULL, kStorageFlags);
+	mapped = static_cast<char*>(glMapNamedBufferRange(buffer, 0, size, kStorageFlags));
+	if (!mapped)
+		std::cout << "ERROR::UPLOAD_RING::MAP_FAILED " << size << " bytes" << std::endl;
+}
+
+void UploadRing::wait(unsigned int region) {
+	GLsync fence = static_cast<GLsync>(fences[region]);
+	if (!fence)
+		return;
+	// the first wait flushes, so the fence is sure to be signaled eventually
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	for (;;) {
+		GLenum result = glClientWaitSync(fence, flags, 1000000000);
+		if (result != GL_TIMEOUT_EXPIRED)
+			break;
+		flags = 0;
+	}
+	glDeleteSync(fence);
+	fences[region] = nullptr;
+}
+
+void UploadRing::BeginFrame() {
+	frame++;
+	region = (region + 1) % framesInFlight;
+	used = 0;
+	wait(region);
+
+	// every frame up to the one that used this region last is done now
+	for (size_t i = 0; i < retired.size();) {
+		if (retired[i].frame + framesInFlight <= frame) {
+			glDeleteBuffers(1, &retired[i].buffer);
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else
+			++i;
+	}
+}
+
+void UploadRing::EndFrame() {
+	if (fences[region])
+		glDeleteSync(static_cast<GLsync>(fences[region]));
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UploadRing::grow(size_t required) {
+	// draws recorded earlier in the frame still point at the old buffer, it lives on until they are done
+	Retired old = { buffer, frame };
+	retired.push_back(old);
+	while (frameSize < required)
+		frameSize *= 2;
+	create();
+	used = 0;
+}
+
+UploadRing::Allocation UploadRing::Allocate(size_t size, size_t alignment) {
+	size_t start = alignUp(used, std::max<size_t>(alignment, 1));
+	if (start + size > frameSize) {
+		grow(alignUp(size, 256) + alignment);
+		start = 0;
+	}
+	Allocation allocation;
+	allocation.buffer = buffer;
+	allocation.offset = region * frameSize + start;
+	allocation.size = size;
+	allocation.data = mapped ? mapped + allocation.offset : nullptr;
+	used = start + size;
+	return allocation;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Frame transient upload memory for data that is rewritten every frame (dynamic vertices, instance transforms,
+// bone palettes, indirect commands). one buffer is created with persistent, coherent storage and stays mapped,
+// it is split into framesInFlight regions and every frame bumps its allocations out of the next one, so an
+// upload is a memcpy into memory no draw in flight reads. EndFrame fences the region after the frame's commands
+// and BeginFrame waits on the fence of the region it is about to reuse, which only blocks when the CPU is
+// framesInFlight frames ahead of the GPU. needs OpenGL 4.4 or ARB_buffer_storage (the application asks for a 4.5
+// context), without them every allocation comes back with NULL data.
+class UploadRing {
+public:
+	struct Allocation {
+		// write pointer, NULL for a failed allocation
+		void* data;
+		// buffer name and byte offset to bind the data with
+		unsigned int buffer;
+		size_t offset;
+		size_t size;
+	};
+
+	explicit UploadRing(size_t frameSize = 1 << 18, unsigned int framesInFlight = 3);
+	~UploadRing();
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	void BeginFrame();
+	// call after the last command reading this frame's allocations
+	void EndFrame();
+
+	// size bytes at a multiple of alignment, valid until the region comes around again. a frame that runs out of
+	// its region moves to a bigger buffer, the allocations it made before stay valid
+	Allocation Allocate(size_t size, size_t alignment = 16);
+	// aligned for glBindBufferRange on GL_UNIFORM_BUFFER / GL_SHADER_STORAGE_BUFFER
+	Allocation AllocateUniform(size_t size) { return Allocate(size, uniformAlignment); }
+	Allocation AllocateStorage(size_t size) { return Allocate(size, storageAlignment); }
+
+	unsigned int GetBuffer() const { return buffer; }
+	// bytes handed out in the current frame
+	size_t GetFrameBytes() const { return used; }
+
+private:
+	// a buffer replaced by a bigger one, deleted once the frames that used it are done
+	struct Retired {
+		unsigned int buffer;
+		unsigned long long frame;
+	};
+
+	unsigned int buffer;
+	char* mapped;
+	size_t frameSize;
+	unsigned int framesInFlight;
+	unsigned int region;
+	size_t used;
+	unsigned long long frame;
+	std::vector<void*> fences;
+	std::vector<Retired> retired;
+	size_t uniformAlignment, storageAlignment;
+
+	void create();
+	void grow(size_t required);
+	void wait(unsigned int region);
+};
@@ -0,0 +1,187 @@
+// Builds a .pak archive (see src/PackFormat.h) from a directory tree:
+//   packer <directory> <archive> [--lz4]
+// paths are stored as found, relative to the working directory, so "packer res res.pak" run from the
+// solution directory stores "res/shaders/1.color.fs" and the application finds it under the same name.
+// with --lz4 every entry that shrinks by at least 10% is stored compressed.
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "PackFormat.h"
+#include "Lz4.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+	struct InputFile {
+		std::string path;
+		uint64_t hash;
+	};
+
+	// appends all regular files below directory, depth first
+	bool listFiles(const std::string& directory, std::vector<std::string>& files) {
+#ifdef _WIN32
+		WIN32_FIND_DATAA found;
+		HANDLE search = FindFirstFileA((directory + "/*").c_str(), &found);
+		if (search == INVALID_HANDLE_VALUE)
+			return false;
+		do {
+			std::string name = found.cFileName;
+			if (name == "." || name == "..")
+				continue;
+			std::string path = directory + "/" + name;
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				listFiles(path, files);
+			else
+				files.push_back(path);
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+#else
+		DIR* handle = opendir(directory.c_str());
+		if (!handle)
+			return false;
+		while (dirent* found = readdir(handle)) {
+			std::string name = found->d_name;
+			if (name == "." || name == "..")
+				continue;
+			std::string path = directory + "/" + name;
+			struct stat status;
+			if (stat(path.c_str(), &status) != 0)
+				continue;
+			if (S_ISDIR(status.st_mode))
+				listFiles(path, files);
+			else if (S_ISREG(status.st_mode))
+				files.push_back(path);
+		}
+		closedir(handle);
+#endif
+		return true;
+	}
+
+	bool writeAt(FILE* output, uint64_t offset, const void* data, size_t size) {
+		uint64_t position = uint64_t(ftell(output));
+		static const char zeros[pack::kAlignment] = {};
+		for (; position < offset; position += std::min<uint64_t>(offset - position, sizeof(zeros)))
+			if (fwrite(zeros, 1, size_t(std::min<uint64_t>(offset - position, sizeof(zeros))), output) == 0)
+				return false;
+		return size == 0 || fwrite(data, 1, size, output) == size;
+	}
+
+	uint64_t align(uint64_t offset) {
+		return (offset + pack::kAlignment - 1) / pack::kAlignment * pack::kAlignment;
+	}
+}
+
+int main(int argc, char** argv) {
+
+	if (argc < 3) {
+		printf("usage: packer <directory> <archive> [--lz4]\n");
+		return 1;
+	}
+	std::string root = pack::normalizePath(argv[1]);
+	std::string archive = argv[2];
+	bool compress = argc > 3 && strcmp(argv[3], "--lz4") == 0;
+
+	std::vector<std::string> found;
+	if (!listFiles(root, found)) {
+		printf("PACKER::ERROR:: can't list %s\n", root.c_str());
+		return 1;
+	}
+
+	std::vector<InputFile> inputs;
+	for (const std::string& path : found) {
+		std::string normalized = pack::normalizePath(path);
+		// never pack the archive into itself
+		if (normalized == pack::normalizePath(archive))
+			continue;
+		InputFile input = { normalized, pack::hashPath(normalized) };
+		inputs.push_back(input);
+	}
+	std::sort(inputs.begin(), inputs.end(), [](const InputFile& a, const InputFile& b) {
+		return a.hash < b.hash;
+	});
+	for (size_t i = 1; i < inputs.size(); ++i) {
+		if (inputs[i].hash == inputs[i - 1].hash) {
+			printf("PACKER::ERROR:: %s and %s have the same path hash\n", inputs[i - 1].path.c_str(), inputs[i].path.c_str());
+			return 1;
+		}
+	}
+
+	FILE* output = fopen(archive.c_str(), "wb");
+	if (!output) {
+		printf("PACKER::ERROR:: can't create %s\n", archive.c_str());
+		return 1;
+	}
+
+	pack::Header header = {};
+	header.magic = pack::kMagic;
+	header.version = pack::kVersion;
+	header.entryCount = uint32_t(inputs.size());
+	std::vector<pack::Entry> entries(inputs.size());
+	std::string paths;
+	uint64_t offset = align(sizeof(header));
+	uint64_t totalSize = 0, totalStored = 0;
+	std::vector<char> compressed;
+	bool ok = writeAt(output, 0, &header, sizeof(header));
+
+	for (size_t i = 0; i < inputs.size() && ok; ++i) {
+		MappedFile file(inputs[i].path);
+		if (!file.IsOpen()) {
+			printf("PACKER::ERROR:: can't read %s\n", inputs[i].path.c_str());
+			ok = false;
+			break;
+		}
+
+		pack::Entry& entry = entries[i];
+		entry.pathHash = inputs[i].hash;
+		entry.offset = offset;
+		entry.size = file.GetSize();
+		entry.storedSize = file.GetSize();
+		entry.pathOffset = uint32_t(paths.size());
+		entry.pathLength = uint32_t(inputs[i].path.size());
+		paths += inputs[i].path;
+
+		const char* stored = file.GetData();
+		if (compress && file.GetSize() > 0) {
+			compressed.resize(lz4::compressBound(file.GetSize()));
+			size_t compressedSize = lz4::compress(compressed.data(), compressed.size(), file.GetData(), file.GetSize());
+			if (compressedSize > 0 && compressedSize <= file.GetSize() / 10 * 9) {
+				entry.flags |= pack::kFlagLz4;
+				entry.storedSize = compressedSize;
+				stored = compressed.data();
+			}
+		}
+
+		ok = writeAt(output, entry.offset, stored, size_t(entry.storedSize));
+		offset = align(entry.offset + entry.storedSize);
+		totalSize += entry.size;
+		totalStored += entry.storedSize;
+		printf("%-60s %10llu -> %10llu%s\n", inputs[i].path.c_str(), (unsigned long long)entry.size,
+			(unsigned long long)entry.storedSize, (entry.flags & pack::kFlagLz4) ? " lz4" : "");
+	}
+
+	header.indexOffset = offset;
+	header.pathsOffset = offset + entries.size() * sizeof(pack::Entry);
+	header.pathsSize = paths.size();
+	ok = ok && writeAt(output, header.indexOffset, entries.data(), entries.size() * sizeof(pack::Entry))
+		&& writeAt(output, header.pathsOffset, paths.data(), paths.size())
+		&& fseek(output, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, output) == 1;
+	if (fclose(output) != 0 || !ok) {
+		printf("PACKER::ERROR:: writing %s failed\n", archive.c_str());
+		remove(archive.c_str());
+		return 1;
+	}
+
+	printf("%s: %u files, %llu -> %llu bytes\n", archive.c_str(), header.entryCount, (unsigned long long)totalSize, (unsigned long long)totalStored);
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include "Tests.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "ObjLoader.h"
+
+namespace {
+
+	// writes source to a file next to the executable, loads it and removes it again
+	bool loadSource(ObjModel& model, const std::string& source, unsigned int threadCount = 0) {
+		const char* path = "obj_loader_test.obj";
+		{
+			std::ofstream file(path, std::ios::binary);
+			file << source;
+		}
+		bool loaded = geometry::loadObj(model, path, threadCount);
+		std::remove(path);
+		return loaded;
+	}
+
+	const char* kPositions =
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 0 1 0\n"
+		"v 1 1 0\n"
+		"vt 0 0\n"
+		"vt 1 0\n"
+		"vt 0 1\n"
+		"vn 0 0 1\n";
+}
+
+TEST(ObjLoaderReadsTrianglesAndQuads) {
+	ObjModel model;
+	CHECK(loadSource(model, std::string(kPositions) + "f 1/1/1 2/2/1 3/3/1\nf 2 4 3\n"));
+	CHECK(model.meshes.size() == 1);
+	if (model.meshes.size() == 1) {
+		CHECK(model.meshes[0].indices.size() == 6);
+		for (unsigned int index : model.meshes[0].indices)
+			CHECK(index < model.meshes[0].vertices.size());
+	}
+
+	ObjModel quad;
+	CHECK(loadSource(quad, std::string(kPositions) + "f -4 -3 -1 -2\n"));
+	CHECK(quad.meshes.size() == 1 && quad.meshes[0].indices.size() == 6);
+}
+
+TEST(ObjLoaderRejectsCornersWithoutPosition) {
+	ObjModel withUvAndNormal;
+	CHECK(!loadSource(withUvAndNormal, std::string(kPositions) + "f /1/1 /2/1 /3/1\n"));
+	ObjModel withUv;
+	CHECK(!loadSource(withUv, std::string(kPositions) + "f /1 /2 /3\n"));
+	ObjModel withNormal;
+	CHECK(!loadSource(withNormal, std::string(kPositions) + "f 1//1 //1 3//1\n"));
+	// behind valid faces and parsed on several chunks
+	std::string source = kPositions;
+	for (int i = 0; i < 1000; ++i)
+		source += "f 1 2 3\n";
+	source += "f /1/1 /2/1 /3/1\n";
+	ObjModel chunked;
+	CHECK(!loadSource(chunked, source, 4));
+}
+
+TEST(ObjLoaderRejectsIndicesOutOfRange) {
+	ObjModel tooLarge;
+	CHECK(!loadSource(tooLarge, std::string(kPositions) + "f 1 2 5\n"));
+	ObjModel zero;
+	CHECK(!loadSource(zero, std::string(kPositions) + "f 0 1 2\n"));
+	ObjModel relative;
+	CHECK(!loadSource(relative, std::string(kPositions) + "f -5 -1 -2\n"));
+	ObjModel uv;
+	CHECK(!loadSource(uv, std::string(kPositions) + "f 1/4 2/1 3/1\n"));
+}
@@ -0,0 +1,64 @@
+#include "Tests.h"
+#include "glm/ext/matrix_clip_space.hpp"
+#include "glm/trigonometric.hpp"
+#include "OcclusionBuffer.h"
+
+namespace {
+
+	// camera at the origin looking down -z, near plane at 0.1
+	glm::mat4 projection() {
+		return glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	}
+
+	// one triangle over the whole view, its corners at the given view depths
+	void addScreenTriangle(OcclusionBuffer& buffer, float depth0, float depth1, float depth2) {
+		glm::vec3 positions[3] = {
+			glm::vec3(-100.0f * depth0, -100.0f * depth0, -depth0),
+			glm::vec3(100.0f * depth1, -100.0f * depth1, -depth1),
+			glm::vec3(0.0f, 100.0f * depth2, -depth2)
+		};
+		unsigned int indices[3] = { 0, 1, 2 };
+		buffer.AddOccluder(positions, 3, indices, 3, glm::mat4(1.0f));
+	}
+
+	bool isBoxBehindVisible(const OcclusionBuffer& buffer) {
+		return buffer.IsBoxVisible(glm::vec3(-0.5f, -0.5f, -10.5f), glm::vec3(0.5f, 0.5f, -9.5f));
+	}
+}
+
+TEST(OcclusionBufferHidesBoxBehindWall) {
+	OcclusionBuffer buffer(256, 192);
+	buffer.Begin(projection());
+	addScreenTriangle(buffer, 5.0f, 5.0f, 5.0f);
+	buffer.Rasterize();
+	CHECK(buffer.GetTriangleCount() == 1);
+	CHECK(!isBoxBehindVisible(buffer));
+	// in front of the wall
+	CHECK(buffer.IsBoxVisible(glm::vec3(-0.5f, -0.5f, -2.5f), glm::vec3(0.5f, 0.5f, -1.5f)));
+}
+
+TEST(OcclusionBufferSkipsOccludersNearerThanNearPlane) {
+	// the GPU clips this one away entirely, w is still positive
+	OcclusionBuffer buffer(256, 192);
+	buffer.Begin(projection());
+	addScreenTriangle(buffer, 0.05f, 0.05f, 0.05f);
+	buffer.Rasterize();
+	CHECK(buffer.GetTriangleCount() == 0);
+	CHECK(isBoxBehindVisible(buffer));
+}
+
+TEST(OcclusionBufferSkipsOccludersCrossingNearPlane) {
+	// one corner between the camera and the near plane, the rest beyond the box
+	OcclusionBuffer buffer(256, 192);
+	buffer.Begin(projection());
+	addScreenTriangle(buffer, 0.05f, 20.0f, 20.0f);
+	buffer.Rasterize();
+	CHECK(buffer.GetTriangleCount() == 0);
+	CHECK(isBoxBehindVisible(buffer));
+
+	// boxes reaching in front of the near plane are visible whatever is rasterized
+	buffer.Begin(projection());
+	addScreenTriangle(buffer, 5.0f, 5.0f, 5.0f);
+	buffer.Rasterize();
+	CHECK(buffer.IsBoxVisible(glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, -0.05f)));
+}
@@ -0,0 +1,47 @@
+#include "Tests.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+	struct Test {
+		const char* name;
+		tests::Function function;
+	};
+
+	// filled by the static Registrations before main
+	std::vector<Test>& registry() {
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	int failures = 0;
+}
+
+tests::Registration::Registration(const char* name, Function function) {
+	Test test = { name, function };
+	registry().push_back(test);
+}
+
+void tests::fail(const char* file, int line, const char* expression) {
+	std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failures++;
+}
+
+int main(int argc, char** argv) {
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int run = 0, failed = 0;
+	for (const Test& test : registry()) {
+		if (filter && !std::strstr(test.name, filter))
+			continue;
+		int before = failures;
+		test.function();
+		run++;
+		if (failures != before)
+			failed++;
+		std::printf("%s %s\n", failures != before ? "FAIL" : "ok  ", test.name);
+	}
+	std::printf("%d of %d tests passed\n", run - failed, run);
+	return failed ? 1 : 0;
+}
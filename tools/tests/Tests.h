@@ -0,0 +1,27 @@
+#pragma once
+
+// The smallest test harness that does the job: TEST(name) { ... } registers a function that main runs once,
+// CHECK(expression) reports a failed expression with its file and line and marks the run as failed.
+//   tests            runs every test
+//   tests <name>     runs the tests whose name contains <name>
+namespace tests {
+
+	typedef void (*Function)();
+
+	struct Registration {
+		Registration(const char* name, Function function);
+	};
+
+	void fail(const char* file, int line, const char* expression);
+}
+
+#define TEST(name) \
+	static void name(); \
+	static tests::Registration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { \
+		if (!(expression)) \
+			tests::fail(__FILE__, __LINE__, #expression); \
+	} while (false)